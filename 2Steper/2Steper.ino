@@ -47,6 +47,8 @@ AccelStepper stepper2(HALFSTEP, motorPin5, motorPin7, motorPin6, motorPin8);
 void setup() 
 {
   Serial.begin(9600);
+  stepper1.setFixedPoint();         //定点数计算加减速，每步的计算时间大大缩短，最高速度可以更高
+  stepper2.setFixedPoint();
   stepper1.setMaxSpeed(800.0);     //最大速度，过高扭矩变小，超过256容易丢步
   stepper1.setAcceleration(200.0);  //加速度，试稳定程序可以调节。
   stepper1.setSpeed(50);           //速度
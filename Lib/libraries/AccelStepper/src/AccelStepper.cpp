@@ -94,8 +94,26 @@ void AccelStepper::setCurrentPosition(long position)
     _speed = 0.0;
 }
 
+// The fixed point ramp takes the steps to stop (Equation 16) from the ramp step
+// counter: _n - 1 while accelerating and -_n while decelerating. The floating
+// point ramp computes them from the speed, and the two agree while the ramp is
+// shorter than this many steps. Past about 6700 steps Equation 13 drifts far
+// enough that the floating point value rounds down a step, so longer ramps stay
+// on the floating point ramp
+#define FIXED_RAMP_EXACT_STEPS 6000
+
+// When maxSpeed^2/2a is closer than this above a whole number, the steps to stop
+// from max speed sit on a rounding boundary of the floating point ramp
+#define FIXED_RAMP_MIN_FRACTION 0.01
+
 void AccelStepper::computeNewSpeed()
 {
+    if (_fixedRamp)
+    {
+	computeNewSpeedFixed();
+	return;
+    }
+
     long distanceTo = distanceToGo(); // +ve is clockwise from curent location
 
     long stepsToStop = (long)((_speed * _speed) / (2.0 * _acceleration)); // Equation 16
@@ -106,6 +124,8 @@ void AccelStepper::computeNewSpeed()
 	_stepInterval = 0;
 	_speed = 0.0;
 	_n = 0;
+	// A move handed over by computeNewSpeedFixed() ends here
+	_fixedRamp = _fixedPoint && _stepsToStopMax < FIXED_RAMP_EXACT_STEPS;
 	return;
     }
 
@@ -176,6 +196,146 @@ void AccelStepper::computeNewSpeed()
 #endif
 }
 
+void AccelStepper::computeNewSpeedFixed()
+{
+    if (_cruiseFloat && _n > 0 && _cnFixed == _cminFixed)
+    {
+	// At max speed with maxSpeed^2/2a on a whole number. The floating point
+	// Equation 16 then rounds either way from step to step, so hand the rest of
+	// the move to the floating point ramp. It starts from the same _n and
+	// _cn == _cmin, so the schedule is the floating point one exactly
+	_fixedRamp = false;
+	_cn = _cmin;
+	_speed = 1000000.0 / _cn;
+	if (_direction == DIRECTION_CCW)
+	    _speed = -_speed;
+	computeNewSpeed();
+	return;
+    }
+
+    long distanceTo = distanceToGo(); // +ve is clockwise from curent location
+
+    long stepsToStop;
+    if (_speed == 0.0)
+	stepsToStop = 0;
+    else if (_n > 0 && _cnFixed == _cminFixed)
+	stepsToStop = _stepsToStopMax; // Cruising at max speed
+    else if (_n > 0)
+	stepsToStop = _n - 1;
+    else
+	stepsToStop = -_n;
+
+    if (distanceTo == 0 && stepsToStop <= 1)
+    {
+	// We are at the target and its time to stop
+	_stepInterval = 0;
+	_speed = 0.0;
+	_n = 0;
+	return;
+    }
+
+    if (distanceTo > 0)
+    {
+	if (_n > 0)
+	{
+	    if ((stepsToStop >= distanceTo) || _direction == DIRECTION_CCW)
+		_n = -stepsToStop; // Start deceleration
+	}
+	else if (_n < 0)
+	{
+	    if ((stepsToStop < distanceTo) && _direction == DIRECTION_CW)
+		_n = -_n; // Start accceleration
+	}
+    }
+    else if (distanceTo < 0)
+    {
+	if (_n > 0)
+	{
+	    if ((stepsToStop >= -distanceTo) || _direction == DIRECTION_CW)
+		_n = -stepsToStop; // Start deceleration
+	}
+	else if (_n < 0)
+	{
+	    if ((stepsToStop < -distanceTo) && _direction == DIRECTION_CCW)
+		_n = -_n; // Start accceleration
+	}
+    }
+
+    if (_n == 0)
+    {
+	// First step from stopped. _speed is only kept up to date at the start
+	// and end of a ramp, speed() computes it from _cnFixed in between
+	_cnFixed = _c0Fixed;
+	_direction = (distanceTo > 0) ? DIRECTION_CW : DIRECTION_CCW;
+	_speed = 1000000.0 / _c0;
+	if (_direction == DIRECTION_CCW)
+	    _speed = -_speed;
+    }
+    else
+    {
+	// Equation 13 with rounding, _cnFixed < 2^30 so the doubling cannot overflow
+	unsigned long denominator = (_n > 0) ? (4 * _n + 1) : -(4 * _n + 1);
+	unsigned long delta = ((_cnFixed << 1) + denominator / 2) / denominator;
+	if (_n > 0)
+	    _cnFixed -= delta;
+	else
+	    _cnFixed += delta;
+	if (_cnFixed < _cminFixed)
+	    _cnFixed = _cminFixed;
+    }
+    _n++;
+    _stepInterval = _cnFixed >> _cShift;
+    if (_n == 0)
+    {
+	// Last step of a deceleration ramp. speed() returns _speed while _n is 0
+	_speed = (1000000.0 * (1UL << _cShift)) / _cnFixed;
+	if (_direction == DIRECTION_CCW)
+	    _speed = -_speed;
+    }
+}
+
+void AccelStepper::computeFixedPointScale()
+{
+    uint8_t oldShift = _cShift;
+    float cmax = max(_c0, _cmin);
+
+    _cShift = 0;
+    while (_cShift < 20 && cmax * (float)(1UL << (_cShift + 1)) < 1073741824.0)
+	_cShift++;
+    _c0Fixed = (unsigned long)(_c0 * (1UL << _cShift) + 0.5);
+    _cminFixed = (unsigned long)(_cmin * (1UL << _cShift) + 0.5);
+    if (_cShift > oldShift)
+	_cnFixed <<= _cShift - oldShift;
+    else
+	_cnFixed >>= oldShift - _cShift;
+
+    // The constructor's maxSpeed 1 and acceleration 1 give 5e11 steps, which does
+    // not fit in a long on AVR. Past FIXED_RAMP_EXACT_STEPS only the comparison
+    // below uses the value, so clamp it there before converting
+    float maxSpeed = 1000000.0 / _cmin;
+    float stepsToStop = (maxSpeed * maxSpeed) / (2.0 * _acceleration); // Equation 16
+    _stepsToStopMax = stepsToStop < FIXED_RAMP_EXACT_STEPS ? (long)stepsToStop : FIXED_RAMP_EXACT_STEPS;
+    _cruiseFloat = stepsToStop - _stepsToStopMax < FIXED_RAMP_MIN_FRACTION;
+
+    // Switch ramps if the ramp length crossed FIXED_RAMP_EXACT_STEPS
+    bool fixedRamp = _fixedPoint && _stepsToStopMax < FIXED_RAMP_EXACT_STEPS;
+    if (fixedRamp && !_fixedRamp)
+	_cnFixed = (unsigned long)(_cn * (1UL << _cShift) + 0.5);
+    else if (!fixedRamp && _fixedRamp)
+    {
+	_speed = speed();
+	_cn = (float)_cnFixed / (1UL << _cShift);
+    }
+    _fixedRamp = fixedRamp;
+}
+
+void AccelStepper::setFixedPoint(bool fixedPoint)
+{
+    _fixedPoint = fixedPoint;
+    _fixedRamp = _fixedPoint && _stepsToStopMax < FIXED_RAMP_EXACT_STEPS;
+    _cnFixed = (unsigned long)(_cn * (1UL << _cShift) + 0.5);
+}
+
 // Run the motor to implement speed and acceleration in order to proceed to the target position
 // You must call this at least once per step, preferably in your main loop
 // If the motor is in the desired position, the cost is very small
@@ -212,6 +372,14 @@ AccelStepper::AccelStepper(uint8_t interface, uint8_t pin1, uint8_t pin2, uint8_
     _cn = 0.0;
     _cmin = 1.0;
     _direction = DIRECTION_CCW;
+    _fixedPoint = false;
+    _fixedRamp = false;
+    _cruiseFloat = false;
+    _cShift = 0;
+    _c0Fixed = 0;
+    _cnFixed = 0;
+    _cminFixed = 1;
+    _stepsToStopMax = 0;
 
     int i;
     for (i = 0; i < 4; i++)
@@ -248,6 +416,14 @@ AccelStepper::AccelStepper(void (*forward)(), void (*backward)())
     _cn = 0.0;
     _cmin = 1.0;
     _direction = DIRECTION_CCW;
+    _fixedPoint = false;
+    _fixedRamp = false;
+    _cruiseFloat = false;
+    _cShift = 0;
+    _c0Fixed = 0;
+    _cnFixed = 0;
+    _cminFixed = 1;
+    _stepsToStopMax = 0;
 
     int i;
     for (i = 0; i < 4; i++)
@@ -264,10 +440,12 @@ void AccelStepper::setMaxSpeed(float speed)
     {
 	_maxSpeed = speed;
 	_cmin = 1000000.0 / speed;
+	computeFixedPointScale();
 	// Recompute _n from current speed and adjust speed if accelerating or cruising
 	if (_n > 0)
 	{
-	    _n = (long)((_speed * _speed) / (2.0 * _acceleration)); // Equation 16
+	    float currentSpeed = AccelStepper::speed();
+	    _n = (long)((currentSpeed * currentSpeed) / (2.0 * _acceleration)); // Equation 16
 	    computeNewSpeed();
 	}
     }
@@ -291,10 +469,16 @@ void AccelStepper::setAcceleration(float acceleration)
 	// New c0 per Equation 7, with correction per Equation 15
 	_c0 = 0.676 * sqrt(2.0 / acceleration) * 1000000.0; // Equation 15
 	_acceleration = acceleration;
+	computeFixedPointScale();
 	computeNewSpeed();
     }
 }
 
+float   AccelStepper::acceleration()
+{
+    return _acceleration;
+}
+
 void AccelStepper::setSpeed(float speed)
 {
     if (speed == _speed)
@@ -312,6 +496,12 @@ void AccelStepper::setSpeed(float speed)
 
 float AccelStepper::speed()
 {
+    // The fixed point ramp does not update _speed after every step
+    if (_fixedRamp && _n != 0 && _speed != 0.0)
+    {
+	float speed = (1000000.0 * (1UL << _cShift)) / _cnFixed;
+	return (_direction == DIRECTION_CW) ? speed : -speed;
+    }
     return _speed;
 }
 
@@ -636,10 +826,11 @@ void AccelStepper::runToNewPosition(long position)
 
 void AccelStepper::stop()
 {
-    if (_speed != 0.0)
+    float currentSpeed = speed();
+    if (currentSpeed != 0.0)
     {    
-	long stepsToStop = (long)((_speed * _speed) / (2.0 * _acceleration)) + 1; // Equation 16 (+integer rounding)
-	if (_speed > 0)
+	long stepsToStop = (long)((currentSpeed * currentSpeed) / (2.0 * _acceleration)) + 1; // Equation 16 (+integer rounding)
+	if (currentSpeed > 0)
 	    move(stepsToStop);
 	else
 	    move(-stepsToStop);
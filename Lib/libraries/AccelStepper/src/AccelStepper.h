@@ -411,6 +411,11 @@ public:
     /// root to be calculated. Dont call more ofthen than needed
     void    setAcceleration(float acceleration);
 
+    /// returns the acceleration/deceleration rate configured for this stepper
+    /// that was previously set by setAcceleration();
+    /// \return The currently configured acceleration/deceleration
+    float   acceleration();
+
     /// Sets the desired constant speed for use with runSpeed().
     /// \param[in] speed The desired constant speed in steps per
     /// second. Positive is clockwise. Speeds of more than 1000 steps per
@@ -514,6 +519,23 @@ public:
     /// \return true if the speed is not zero or not at the target position
     bool    isRunning();
 
+    /// Selects the fixed point implementation of the acceleration ramp used by run().
+    /// On 8 bit processors the floating point ramp computed after every step limits
+    /// the step rate to a few hundred steps per second. The fixed point ramp keeps the
+    /// step interval as a scaled integer, so each step costs one integer division
+    /// instead of several floating point divisions. It is only used while
+    /// maxSpeed^2/(2*acceleration), the length of the ramp to max speed, is under
+    /// 6000 steps; longer ramps stay on the floating point ramp. If that value is
+    /// within 0.01 above a whole number, the floating point ramp rounds the steps
+    /// to stop either way at max speed and may overshoot the target by 2 steps, so
+    /// cruising and the stop after it are handed over to the floating point ramp.
+    /// In that range the step positions match the floating point ramp and the step
+    /// intervals match to within 1 microsecond, as long as maxSpeed and acceleration
+    /// are not changed during a move (Tools/accelstepper_ramp checks this).
+    /// Only change this while the motor is stopped.
+    /// \param[in] fixedPoint True to use the fixed point ramp, false (default) for floating point
+    void    setFixedPoint(bool fixedPoint = true);
+
 protected:
 
     /// \brief Direction indicator
@@ -534,6 +556,11 @@ protected:
     /// move() or moveTo()
     void           computeNewSpeed();
 
+    /// Fixed point version of computeNewSpeed(), used when setFixedPoint() is enabled.
+    /// Keeps the step interval in _cnFixed, scaled by 2^_cShift, and derives the steps
+    /// needed to stop from the ramp step counter instead of from the current speed.
+    void           computeNewSpeedFixed();
+
     /// Low level function to set the motor output pins
     /// bit 0 of the mask corresponds to _pin[0]
     /// bit 1 of the mask corresponds to _pin[1]
@@ -671,6 +698,31 @@ private:
     /// Min step size in microseconds based on maxSpeed
     float _cmin; // at max speed
 
+    /// Whether setFixedPoint() is enabled
+    bool _fixedPoint;
+
+    /// Whether computeNewSpeed() uses the fixed point ramp right now. False when the
+    /// ramp is too long for it, and for the rest of a move handed over at max speed
+    bool _fixedRamp;
+
+    /// maxSpeed^2/2a is on a whole number, cruise and stop on the floating point ramp
+    bool _cruiseFloat;
+
+    /// Binary scale of the fixed point step sizes, chosen so that
+    /// _c0Fixed and _cminFixed fit in 30 bits
+    uint8_t _cShift;
+
+    /// _c0, _cn and _cmin in microseconds scaled by 2^_cShift
+    unsigned long _c0Fixed;
+    unsigned long _cnFixed;
+    unsigned long _cminFixed;
+
+    /// Steps needed to stop from maxSpeed
+    long _stepsToStopMax;
+
+    /// Recomputes the fixed point step sizes after a change of maxSpeed or acceleration
+    void computeFixedPointScale();
+
 };
 
 /// @example Random.pde
@@ -7,7 +7,10 @@
 #include "AccelStepper.h"
 
 MultiStepper::MultiStepper()
-    : _num_steppers(0)
+    : _num_steppers(0),
+      _accelerated(false),
+      _pathSteps(0),
+      _moving(false)
 {
 }
 
@@ -21,10 +24,57 @@ boolean MultiStepper::addStepper(AccelStepper& stepper)
 
 void MultiStepper::moveTo(long absolute[])
 {
+    uint8_t i;
+    if (_accelerated)
+    {
+	// All steppers cover the same fraction of their distance at any time, so the move is
+	// one profile along the longest distance. A stepper that moves d of those _pathSteps
+	// runs at d / _pathSteps of the path speed and acceleration, which bounds both.
+	_pathSteps = 0;
+	for (i = 0; i < _num_steppers; i++)
+	{
+	    _startPos[i] = _steppers[i]->currentPosition();
+	    _pathSteps = max(_pathSteps, labs(absolute[i] - _startPos[i]));
+	}
+	_moving = false;
+	if (_pathSteps == 0)
+	    return;
+
+	_pathSpeed = 0.0;
+	_pathAccel = 0.0;
+	for (i = 0; i < _num_steppers; i++)
+	{
+	    long thisDistance = labs(absolute[i] - _startPos[i]);
+	    if (thisDistance == 0)
+		continue;
+	    float scale = (float)_pathSteps / thisDistance;
+	    float thisSpeed = _steppers[i]->maxSpeed() * scale;
+	    float thisAccel = _steppers[i]->acceleration() * scale;
+	    if (_pathSpeed == 0.0 || thisSpeed < _pathSpeed)
+		_pathSpeed = thisSpeed;
+	    if (_pathAccel == 0.0 || thisAccel < _pathAccel)
+		_pathAccel = thisAccel;
+	}
+
+	// Trapezoid, or triangle if the move is too short to reach the cruise speed
+	if (_pathSpeed * _pathSpeed > _pathAccel * _pathSteps)
+	    _pathSpeed = sqrt(_pathAccel * _pathSteps);
+	_rampTime = _pathSpeed / _pathAccel;
+	_moveTime = _rampTime + _pathSteps / _pathSpeed;
+
+	for (i = 0; i < _num_steppers; i++)
+	{
+	    // runSpeed() only ever needs to step in the direction of the target, and never
+	    // faster than maxSpeed, the profile decides when
+	    _steppers[i]->moveTo(absolute[i]);
+	    _steppers[i]->setSpeed(absolute[i] >= _startPos[i] ? _steppers[i]->maxSpeed() : -_steppers[i]->maxSpeed());
+	}
+	return;
+    }
+
     // First find the stepper that will take the longest time to move
     float longestTime = 0.0;
 
-    uint8_t i;
     for (i = 0; i < _num_steppers; i++)
     {
 	long thisDistance = absolute[i] - _steppers[i]->currentPosition();
@@ -48,11 +98,48 @@ void MultiStepper::moveTo(long absolute[])
     }
 }
 
+float MultiStepper::pathPosition(float t)
+{
+    if (t >= _moveTime)
+	return _pathSteps;
+    if (t < _rampTime)
+	return 0.5 * _pathAccel * t * t; // Accelerating
+    if (t > _moveTime - _rampTime)
+    {
+	float tleft = _moveTime - t;
+	return _pathSteps - 0.5 * _pathAccel * tleft * tleft; // Decelerating
+    }
+    return _pathSpeed * (t - 0.5 * _rampTime); // Cruising
+}
+
 // Returns true if any motor is still running to the target position.
 boolean MultiStepper::run()
 {
     uint8_t i;
     boolean ret = false;
+    if (_accelerated && _pathSteps != 0)
+    {
+	unsigned long now = micros();
+	if (!_moving)
+	{
+	    _moveStartTime = now;
+	    _moving = true;
+	}
+	float fraction = pathPosition((now - _moveStartTime) * 1e-6) / _pathSteps;
+	for (i = 0; i < _num_steppers; i++)
+	{
+	    long delta = _steppers[i]->targetPosition() - _startPos[i];
+	    long target = _startPos[i] + (long)floor(delta * fraction + 0.5);
+	    // Step only when behind the profile, so every stepper stays on the line
+	    if (_steppers[i]->currentPosition() != target)
+		_steppers[i]->runSpeed();
+	    if (_steppers[i]->distanceToGo() != 0)
+		ret = true;
+	}
+	if (!ret)
+	    _pathSteps = 0; // Move complete
+	return ret;
+    }
     for (i = 0; i < _num_steppers; i++)
     {
 	if ( _steppers[i]->distanceToGo() != 0)
@@ -71,3 +158,8 @@ void    MultiStepper::runSpeedToPosition()
 	;
 }
 
+void    MultiStepper::setCoordinatedAcceleration(bool enable)
+{
+    _accelerated = enable;
+}
+
@@ -27,9 +27,13 @@ class AccelStepper;
 /// 3D printers etc
 /// to get linear straight line movement between arbitrary 2d (or 3d or ...) positions.
 ///
-/// Caution: only constant speed stepper motion is supported: acceleration and deceleration is not supported
-/// All the steppers managed by MultiStepper will step at a constant speed to their
-/// target (albeit perhaps different speeds for each stepper).
+/// By default only constant speed stepper motion is supported: all the steppers managed by
+/// MultiStepper will step at a constant speed to their target (albeit perhaps different
+/// speeds for each stepper).
+/// After setCoordinatedAcceleration(), moveTo() plans one trapezoidal speed profile for the
+/// whole move instead, limited by the maxSpeed() and acceleration() of every stepper, and
+/// run() keeps each stepper on the straight line between the start and target positions
+/// while accelerating and decelerating.
 class MultiStepper
 {
 public:
@@ -60,6 +64,13 @@ public:
     /// Blocks until all that position is acheived. If you dont
     /// want blocking consider using run() instead.
     void    runSpeedToPosition();
+
+    /// Selects coordinated acceleration for the following moveTo() calls.
+    /// The move is planned as a shared trapezoidal profile: the fastest acceleration
+    /// and cruise speed that no managed stepper exceeds its own acceleration() or
+    /// maxSpeed(). The time of the first run() after moveTo() is the start of the ramp.
+    /// \param[in] enable True to accelerate and decelerate, false (default) for constant speed
+    void    setCoordinatedAcceleration(bool enable = true);
     
 private:
     /// Array of pointers to the steppers we are controlling.
@@ -69,6 +80,30 @@ private:
     /// Number of steppers we are controlling and the number
     /// of steppers in _steppers[]
     uint8_t       _num_steppers;
+
+    /// Whether moveTo() plans a trapezoidal profile
+    boolean       _accelerated;
+
+    /// Positions of the steppers when the current move was planned
+    long          _startPos[MULTISTEPPER_MAX_STEPPERS];
+
+    /// Length of the current move in steps of the stepper that moves furthest.
+    /// The profile below is in these units, each stepper covers the same fraction of it
+    long          _pathSteps;
+
+    /// Profile of the current move: acceleration, cruise speed, duration of the
+    /// acceleration (and deceleration) phase and of the whole move in seconds
+    float         _pathAccel;
+    float         _pathSpeed;
+    float         _rampTime;
+    float         _moveTime;
+
+    /// micros() at the first run() of the current move, valid when _moving
+    unsigned long _moveStartTime;
+    boolean       _moving;
+
+    /// Distance along the current move after the given time, in units of _pathSteps
+    float         pathPosition(float t);
 };
 
 /// @example MultiStepper.pde
@@ -0,0 +1,40 @@
+//二进制绘图文件 .wdb：电脑上用 Tools/nc2bin 把 .nc 转好，SD卡固件直接执行，不用再解析文本
+//文件头 5 字节："WDB" 版本号 标志；标志第0位为1时数据里有校验
+//之后是一串操作，每个操作 1 字节操作码，后面跟 0 到 2 个变长整数（varint）：
+//  坐标是相对上一个点的增量，单位 0.01mm，zigzag 后按 7 位一组低位在前，|增量| < 0.64mm 只占 1 字节
+//  G1 X-98.2287Y20.8983 这样的一行 20 字节，变成 3 字节
+//电脑上算好了模态、G91、G20、G92、G28、圆弧切成弦，固件只管走
+
+#ifndef GCodeBinary_h
+#define GCodeBinary_h
+
+#include <stdint.h>
+
+#define WDB_VERSION       1
+#define WDB_FLAG_CHECK    0x01   //带校验
+#define WDB_UNITS_PER_MM  100    //坐标单位 0.01mm
+
+#define WDB_OP_LINE       0x01   //dx dy，画线（按 F 的速度）
+#define WDB_OP_RAPID      0x02   //dx dy，空走（G0 的速度）
+#define WDB_OP_PEN_UP     0x03
+#define WDB_OP_PEN_DOWN   0x04
+#define WDB_OP_FEED       0x05   //F，mm/min，之后的画线按这个速度
+#define WDB_OP_DWELL      0x06   //暂停，毫秒
+#define WDB_OP_CHECK      0x07   //1 字节 CRC-8，校验上一个校验点之后到这个操作码之前的所有字节
+#define WDB_OP_END        0x08   //文件结束
+
+#define WDB_CHECK_BLOCK   256    //带校验时大约每多少字节放一个校验点
+
+//zigzag：负数也变成小的正数，-1 -> 1，1 -> 2
+static inline uint32_t wdb_zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+static inline int32_t wdb_unzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+//CRC-8，多项式 0x07，不用查表，省内存
+static inline uint8_t wdb_crc8(uint8_t crc, uint8_t b)
+{
+  crc ^= b;
+  for (uint8_t i = 0; i < 8; i++) crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+  return crc;
+}
+
+#endif
@@ -0,0 +1,260 @@
+#include "GCodeReader.h"
+
+//派发表：字母，代码，组。表里没有的代码（G40 G94 M6 之类CAM常带的）不进组，也不影响后面的运动
+static const struct {
+  char letter;
+  uint8_t code;
+  uint8_t group;
+} gcode_table[] PROGMEM = {
+  {'G',  0, GCODE_GROUP_MOTION},    {'G',  1, GCODE_GROUP_MOTION},    {'G',  2, GCODE_GROUP_MOTION},    {'G',  3, GCODE_GROUP_MOTION},
+  {'G',  4, GCODE_GROUP_NON_MODAL}, {'G', 28, GCODE_GROUP_NON_MODAL}, {'G', 92, GCODE_GROUP_NON_MODAL}, {'G', 17, GCODE_GROUP_PLANE},
+  {'G', 20, GCODE_GROUP_UNITS},     {'G', 21, GCODE_GROUP_UNITS},     {'G', 90, GCODE_GROUP_DISTANCE},  {'G', 91, GCODE_GROUP_DISTANCE},
+  {'G', 61, GCODE_GROUP_PATH},      {'G', 64, GCODE_GROUP_PATH},      {'G',  7, GCODE_GROUP_NON_MODAL},
+  {'M',  3, GCODE_GROUP_SPINDLE},   {'M',  4, GCODE_GROUP_SPINDLE},   {'M',  5, GCODE_GROUP_SPINDLE},
+  {'M',  2, GCODE_GROUP_STOP},      {'M', 30, GCODE_GROUP_STOP},
+};
+#define GCODE_TABLE_SIZE  (sizeof(gcode_table) / sizeof(gcode_table[0]))
+
+
+GCodeReader::GCodeReader(uint8_t motion)
+{
+  words = 0;
+  for (uint8_t i = 0; i < GCODE_GROUP_COUNT; i++) groups[i] = -1;
+  tok.letter = 0;
+  tok.skip = 0;
+  tok.line_start = true;
+  tok.overflow = false;
+  tok.line_done = false;
+  skipped_bytes = total_lines = 0;
+  modal.motion = motion;
+  modal.inches = false;
+  modal.relative = false;
+  offset[0] = offset[1] = 0;
+  point_fn = NULL;
+}
+
+
+#ifdef ARDUINO
+bool GCodeReader::read(Stream &in, void (*realtime)())
+{
+  while (in.available() > 0) {
+    char c = in.read();
+    if (c == '?' && realtime) { realtime(); continue; }
+    if (parse(c)) return true;
+  }
+  return false;
+}
+#endif
+
+
+void GCodeReader::group_word(char letter, int32_t value)
+{
+  if (value < 0 || value % GCODE_FIXED_SCALE) return;  //G64.1 之类不认
+  int32_t code = value / GCODE_FIXED_SCALE;
+  for (uint8_t i = 0; i < GCODE_TABLE_SIZE; i++) {
+    if (pgm_read_byte(&gcode_table[i].letter) == letter && pgm_read_byte(&gcode_table[i].code) == code) {
+      groups[pgm_read_byte(&gcode_table[i].group)] = code;
+      return;
+    }
+  }
+}
+
+
+void GCodeReader::end_word()
+{
+  if (tok.letter && tok.digits) {
+    int32_t value = tok.negative ? -tok.value : tok.value;
+    if ((tok.letter == 'X' || tok.letter == 'Y') && groups[GCODE_GROUP_NON_MODAL] == 7 && point_fn) {
+      polyline_word(tok.letter, value);
+    } else {
+      values[tok.letter - 'A'] = value;
+      words |= 1UL << (tok.letter - 'A');
+      if (tok.letter == 'G' || tok.letter == 'M') group_word(tok.letter, value);
+    }
+  }
+  tok.letter = 0;
+}
+
+
+//G7 的点：读到 Y 就是一个点；只有 X 时到下一个 X 或行尾才算，Y 增量为 0
+void GCodeReader::polyline_word(char letter, int32_t value)
+{
+  if (letter == 'X' && seen('X')) polyline_point();
+  values[letter - 'A'] = value;
+  words |= 1UL << (letter - 'A');
+  if (letter == 'Y') polyline_point();
+}
+
+void GCodeReader::polyline_point()
+{
+  if (!seen('X') && !seen('Y')) return;
+  //模态要到行尾才记，同一行里的 G20 G21 这里先用上
+  bool inches = groups[GCODE_GROUP_UNITS] >= 0 ? groups[GCODE_GROUP_UNITS] == 20 : modal.inches;
+  float dx = seen('X') ? value('X') : 0, dy = seen('Y') ? value('Y') : 0;
+  if (inches) { dx *= 25.4; dy *= 25.4; }
+  words &= ~((1UL << ('X' - 'A')) | (1UL << ('Y' - 'A')));  //用掉了，行读完后 seen('X') 为 false，不会再按运动模式走一次
+  if (!tok.overflow) point_fn(dx, dy);
+}
+
+
+//一行读完：模态组记进模态状态，有数溢出的行整行不算
+void GCodeReader::end_line()
+{
+  end_word();
+  if (groups[GCODE_GROUP_NON_MODAL] == 7 && point_fn) polyline_point();
+  tok.line_done = true;
+  total_lines++;
+  if (tok.overflow) return;
+  if (groups[GCODE_GROUP_UNITS] >= 0) modal.inches = groups[GCODE_GROUP_UNITS] == 20;
+  if (groups[GCODE_GROUP_DISTANCE] >= 0) modal.relative = groups[GCODE_GROUP_DISTANCE] == 91;
+  if (groups[GCODE_GROUP_MOTION] >= 0) modal.motion = groups[GCODE_GROUP_MOTION];
+}
+
+
+//数值自己逐位累加，不用 strtod：它会把 G0X1 里的 0X1 当成十六进制
+//只做整数乘加；第4位小数四舍五入，再往后的忽略，步距 0.054mm，千分之一毫米足够
+//注释 (...) 和 ; 到行尾、行首 / 的整行（跳段）、空格 回车 制表符，都在这里一个字节一个字节跳过，不复制
+bool GCodeReader::parse(char c)
+{
+  if (tok.line_done) {
+    words = 0;
+    for (uint8_t i = 0; i < GCODE_GROUP_COUNT; i++) groups[i] = -1;
+    tok.skip = 0;
+    tok.line_start = true;
+    tok.overflow = false;
+    tok.line_done = false;
+  }
+  //最常见的字节是数字，先判断
+  if (tok.letter && c >= '0' && c <= '9') {
+    uint8_t d = c - '0';
+    if (!tok.fraction) {
+      if (tok.value > (GCODE_FIXED_MAX - d * (int32_t)GCODE_FIXED_SCALE) / 10) tok.overflow = true;
+      else tok.value = tok.value * 10 + d * (int32_t)GCODE_FIXED_SCALE;
+    } else if (tok.place > 0) {
+      //小数位也会溢出：2147483.999；tok.value 不超过 GCODE_FIXED_MAX，取负时不会碰到 int32_t 最小值
+      if (tok.value > GCODE_FIXED_MAX - d * tok.place) tok.overflow = true;
+      else tok.value += d * tok.place;
+      tok.place /= 10;
+    } else if (tok.place == 0) {
+      if (d >= 5 && tok.value < GCODE_FIXED_MAX) tok.value++;
+      tok.place = -1;
+    }
+    tok.digits = true;
+    return false;
+  }
+  if (c == '\n') {
+    end_line();
+    return true;
+  }
+  if (tok.skip) {
+    skipped_bytes++;
+    if (c == ')' && tok.skip == '(') tok.skip = 0;
+    return false;
+  }
+  if (c == ' ' || c == '\t' || c == '\r') {
+    skipped_bytes++;
+    if (tok.letter && !tok.digits && !tok.fraction) return false;  //字母和数之间的空格
+    end_word();
+    return false;
+  }
+  if (c == '(' || c == ';' || (c == '/' && tok.line_start)) {
+    end_word();
+    tok.skip = c;
+    skipped_bytes++;
+    return false;
+  }
+  tok.line_start = false;
+  if (tok.letter) {
+    bool started = tok.digits || tok.fraction;
+    if (c == '.' && !tok.fraction) { tok.fraction = true; return false; }
+    if ((c == '-' || c == '+') && !started) { tok.negative = c == '-'; return false; }
+    end_word();
+  }
+  if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+  if (c >= 'A' && c <= 'Z') {
+    tok.letter = c;
+    tok.negative = tok.digits = tok.fraction = false;
+    tok.value = 0;
+    tok.place = GCODE_FIXED_SCALE / 10;
+  }
+  else skipped_bytes++;  //% 之类不认的字节
+  return false;
+}
+
+
+bool GCodeReader::seen(char letter)
+{
+  return words & (1UL << (letter - 'A'));
+}
+
+//用到时才除，一个数只除一次；定点数和 1000 在 float 里都是精确的，除出来就是离这个小数最近的 float
+float GCodeReader::value(char letter)
+{
+  return values[letter - 'A'] / (float)GCODE_FIXED_SCALE;
+}
+
+int32_t GCodeReader::fixed(char letter)
+{
+  return values[letter - 'A'];
+}
+
+int8_t GCodeReader::group(uint8_t g)
+{
+  return groups[g];
+}
+
+bool GCodeReader::error()
+{
+  return tok.overflow;
+}
+
+uint32_t GCodeReader::skipped()
+{
+  return skipped_bytes;
+}
+
+uint32_t GCodeReader::lines()
+{
+  return total_lines;
+}
+
+
+uint8_t GCodeReader::motion()
+{
+  return modal.motion;
+}
+
+bool GCodeReader::has_axis()
+{
+  if (seen('X') || seen('Y') || seen('Z')) return true;
+  return (modal.motion == 2 || modal.motion == 3) && (seen('I') || seen('J') || seen('R'));
+}
+
+float GCodeReader::length(char letter)
+{
+  return modal.inches ? value(letter) * 25.4 : value(letter);
+}
+
+float GCodeReader::axis(char letter, float current)
+{
+  if (modal.relative) return current + length(letter);
+  if (letter == 'X' || letter == 'Y') return length(letter) + offset[letter - 'X'];
+  return length(letter);
+}
+
+//Z 决定笔的状态，不偏移
+void GCodeReader::set_origin(char letter, float current)
+{
+  if ((letter == 'X' || letter == 'Y') && seen(letter)) offset[letter - 'X'] = current - length(letter);
+}
+
+void GCodeReader::polyline(void (*point)(float dx, float dy))
+{
+  point_fn = point;
+}
+
+void GCodeReader::program_end()
+{
+  modal.motion = 1;
+  modal.relative = false;
+}
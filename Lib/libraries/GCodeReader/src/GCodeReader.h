@@ -0,0 +1,102 @@
+//G代码前端：串口固件 WallDrawGCODE 和 SD卡固件 WalldrawSDCard 共用
+//逐字节分词，不存整行，注释和跳段不复制直接跳过；数值是 1/1000 的定点数；G M 字按派发表分组；模态状态（G0-G3 G20/G21 G90/G91 G92）也在这里
+//字节从 Stream 来，串口 Serial 和 SD卡的 File 都是 Stream，电脑上也可以直接一个一个字节送给 parse() 测试
+//本文件夹复制到 我的文档->Arduino->libraries 下
+
+#ifndef GCodeReader_h
+#define GCodeReader_h
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+//电脑上编译（主机工具 Tools/nc2bin、测试）：没有 Stream，PROGMEM 就是普通内存
+#include <stdint.h>
+#include <stddef.h>
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#endif
+
+//一行里的G字、M字按组记下，group() 取
+#define GCODE_GROUP_MOTION      0   //G0 G1 G2 G3，模态
+#define GCODE_GROUP_NON_MODAL   1   //G4 G7 G28 G92
+#define GCODE_GROUP_PLANE       2   //G17，只有XY平面
+#define GCODE_GROUP_UNITS       3   //G20 G21，模态
+#define GCODE_GROUP_DISTANCE    4   //G90 G91，模态
+#define GCODE_GROUP_PATH        5   //G61 G64，模态
+#define GCODE_GROUP_SPINDLE     6   //M3 M4 M5，落笔抬笔
+#define GCODE_GROUP_STOP        7   //M2 M30 程序结束
+#define GCODE_GROUP_COUNT       8
+
+#define GCODE_FIXED_SCALE  1000          //数值单位 1/1000（坐标就是微米）
+#define GCODE_FIXED_MAX    2147483647L  //int32_t 最大值，约 ±2147 米
+
+class GCodeReader
+{
+  public:
+    GCodeReader(uint8_t motion = 0);  //开机的运动模式，Grbl 是 G0
+
+    //读字节直到一行读完返回 true，Stream 里暂时没有字节了返回 false，下次接着读
+    //realtime 不为空时 '?' 不进分词器，交给它（Grbl 的实时状态查询）
+#ifdef ARDUINO
+    bool read(Stream &in, void (*realtime)() = NULL);
+#endif
+    bool parse(char c);  //送入一个字节，读完一行返回 true
+
+    //读完一行后取这一行的内容
+    bool seen(char letter);
+    float value(char letter);
+    int32_t fixed(char letter);   //定点数原值
+    int8_t group(uint8_t g);      //这一组的代码，-1 表示这一行没有
+    bool error();                 //这一行有数溢出，整行不要执行，模态也没改
+
+    //统计：跳过的（注释、跳段、空白）字节数，读完的行数；总字节数看文件大小，这里不再每个字节加一次
+    uint32_t skipped();
+    uint32_t lines();
+
+    //模态状态
+    uint8_t motion();                        //0 1 2 3
+    bool has_axis();                         //这一行有 X Y Z，圆弧模式下 I J R 也算
+    float length(char letter);               //G20 时英寸换成毫米
+    float axis(char letter, float current);  //目标坐标：G91 加到 current 上，G90 加上 G92 偏移；current 是这个轴现在的坐标
+    void set_origin(char letter, float current);  //G92：这个轴现在的坐标设成行里的值，只有 X Y
+    void program_end();                      //M2 M30：回到 G1 G90
+
+    //G7 折线（本项目自己的扩展）：G7 后面跟任意多对 X Y，每对是相对上一个点的增量（mm，G20 时英寸），按 F 画线
+    //G7 X.35Y-.2X1.1Y.05X.6Y.6 ... 一行顶几十行 G1，串口一行只回一次 ok
+    //读到一个点就交给 point，不存整行，行多长都行；G7 和 F 要写在点前面，行里数溢出之后的点不交
+    void polyline(void (*point)(float dx, float dy));
+
+  private:
+    void end_word();
+    void group_word(char letter, int32_t value);
+    void end_line();
+    void polyline_word(char letter, int32_t value);
+    void polyline_point();
+
+    int32_t values[26];     //按字母索引，每个字母只留一行里最后一次出现的值
+    uint32_t words;         //第 n 位表示字母 'A'+n 出现过
+    int8_t groups[GCODE_GROUP_COUNT];
+
+    struct {
+      char letter;          //正在读数值的字母，0 表示不在字里
+      char skip;            //跳过到行尾或 ')'：'(' 括号注释，';' 分号注释，'/' 跳段，0 不跳
+      bool line_start;      //这一行到现在只有空白，'/' 在这里才是跳段
+      bool negative, digits, fraction;
+      int32_t value;        //已读的数，单位 1/1000
+      int16_t place;        //下一位小数的位值：100 10 1，0 是第4位只用来四舍五入，-1 之后的位不要了
+      bool overflow;        //这一行有数超出 ±2147483.647
+      bool line_done;       //上一行已经交出去，下一个字节开始新的一行
+    } tok;
+
+    //模态状态：一直有效，直到被同组的G字改掉
+    struct {
+      uint8_t motion;
+      bool inches;          //G20 英寸，G21 毫米
+      bool relative;        //G91 相对坐标，G90 绝对坐标
+    } modal;
+    float offset[2];        //G92 X Y 偏移：机器坐标 = 程序坐标 + 偏移
+    uint32_t skipped_bytes, total_lines;
+    void (*point_fn)(float dx, float dy);
+};
+
+#endif
@@ -435,6 +435,22 @@ bool TinyStepper_28BYJ_48::processMovement(void)
 
 
 
+//
+// move one step right now, there is no acceleration ramp and no waiting, the
+// caller is responsible for the timing between steps (used when an external
+// step generator schedules the steps of several motors)
+//  Enter:  direction = 1 to step forward, -1 to step backward 
+//
+void TinyStepper_28BYJ_48::takeStep(int direction)
+{
+  setNextFullStep(direction);
+  currentPosition_InSteps += direction;
+  targetPosition_InSteps = currentPosition_InSteps;
+  currentStepPeriod_InUS = 0.0;
+}
+
+
+
 //
 // update the IO pins for the next full step
 //  Enter:  direction = 1 to step forward, -1 to step backward 
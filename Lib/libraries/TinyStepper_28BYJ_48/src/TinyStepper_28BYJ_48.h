@@ -11,7 +11,7 @@
 #ifndef TinyStepper_28BYJ_48_h
 #define TinyStepper_28BYJ_48_h
 
-#include <arduino.h>
+#include <Arduino.h>
 #include <stdlib.h>
 
 
@@ -38,6 +38,7 @@ class TinyStepper_28BYJ_48
     bool motionComplete();
     float getCurrentVelocityInStepsPerSecond(); 
     bool processMovement(void);
+    void takeStep(int direction);
     void disableMotor();
 
 
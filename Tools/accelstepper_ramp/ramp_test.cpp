@@ -0,0 +1,92 @@
+//accelstepper_ramp：AccelStepper 浮点加减速（computeNewSpeed）和定点加减速（setFixedPoint）的步进时刻对比
+//和 2Steper 一样来回走：走到目标后 moveTo(-currentPosition())，每种加速度、最高速度、距离都走 REVERSALS 趟
+//两边每一步的位置必须一样，步间隔相差不超过 1 微秒；不通过时打印第一处不同前后几步，返回 1
+//
+//编译（在本文件夹里）：
+//  g++ -O2 -DARDUINO=100 -I../host -I../../Lib/libraries/AccelStepper/src ramp_test.cpp ../host/host.cpp ../../Lib/libraries/AccelStepper/src/AccelStepper.cpp -o ramp_test
+//用法：
+//  ramp_test                      跑全部组合
+//  ramp_test 加速度 最高速度 距离   只跑一组，例：ramp_test 200 1500 6000
+
+#include <AccelStepper.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#define REVERSALS  4
+#define MAX_STEPS  2000000L
+
+struct step_t {
+  unsigned long dt;  //和上一步的间隔 微秒
+  long pos;
+};
+
+//假时间一微秒一微秒地走，每微秒调一次 run()，步间隔就是 run() 算出的间隔
+//离下一步还远时直接跳到它前 2 微秒：speed() 是 1000000/间隔，没到时间的 run() 不改状态
+static void schedule(bool fixed, float a, float v, long distance, std::vector<step_t> &out)
+{
+  host_tick = 0;
+  host_time = 0;
+  AccelStepper s(AccelStepper::HALF4WIRE, 2, 5, 3, 6, false);
+  if (fixed) s.setFixedPoint();
+  s.setMaxSpeed(v);
+  s.setAcceleration(a);
+  s.moveTo(distance);
+  long last = s.currentPosition();
+  unsigned long last_us = 0;
+  for (int r = 0; r < REVERSALS && out.size() < (size_t)MAX_STEPS;) {
+    if (s.distanceToGo() == 0) {
+      s.moveTo(-s.currentPosition());
+      r++;
+    }
+    s.run();
+    if (s.currentPosition() != last) {
+      out.push_back({host_time - last_us, s.currentPosition()});
+      last_us = host_time;
+      last = s.currentPosition();
+    }
+    unsigned long skip = s.speed() != 0 ? (unsigned long)(1000000.0 / fabs(s.speed())) : 0;
+    if (skip > 2 && host_time - last_us < skip - 2) host_time = last_us + skip - 2;
+    else host_time++;
+  }
+}
+
+static bool compare(float a, float v, long distance)
+{
+  std::vector<step_t> f, x;
+  schedule(false, a, v, distance, f);
+  schedule(true, a, v, distance, x);
+  size_t n = f.size() < x.size() ? f.size() : x.size();
+  size_t bad = n;
+  long worst = 0;
+  for (size_t i = 0; i < n; i++) {
+    long d = labs((long)f[i].dt - (long)x[i].dt);
+    if (d > worst) worst = d;
+    if (bad == n && (d > 1 || f[i].pos != x[i].pos)) bad = i;
+  }
+  if (bad == n && f.size() != x.size()) bad = n - 1;
+  printf("a=%-5g v=%-5g distance=%-6ld %8lu steps  max diff %ld us  %s\n",
+         a, v, distance, (unsigned long)f.size(), bad == n ? worst : labs((long)f[bad].dt - (long)x[bad].dt), bad == n ? "ok" : "FAIL");
+  if (bad == n) return true;
+  for (size_t j = bad > 3 ? bad - 3 : 0; j < bad + 3 && j < n; j++)
+    printf("  step %lu: float dt=%lu pos=%ld  fixed dt=%lu pos=%ld\n",
+           (unsigned long)j, f[j].dt, f[j].pos, x[j].dt, x[j].pos);
+  return false;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc == 4) return compare(atof(argv[1]), atof(argv[2]), atol(argv[3])) ? 0 : 1;
+
+  static const float accels[] = {50, 100, 200, 500, 1000};
+  static const float speeds[] = {256, 500, 800, 1000, 1500};
+  static const long distances[] = {279, 673, 3000, 6000, 12000, 20000};
+  int failed = 0;
+  for (float a : accels)
+    for (float v : speeds)
+      for (long d : distances)
+        if (!compare(a, v, d)) failed++;
+  printf(failed ? "%d cases failed\n" : "all cases passed\n", failed);
+  return failed ? 1 : 0;
+}
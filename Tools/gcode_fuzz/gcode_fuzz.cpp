@@ -0,0 +1,419 @@
+//gcode_fuzz：G代码前端（GCodeReader）和串口固件执行部分（gcode_parser.cpp、QHStepper.cpp 的直线和圆弧）的模糊测试和吞吐量测试
+//规划器换成只做检查的桩：交给规划器的坐标、速度、暂停都必须是有限的数，笔状态只能是抬或落，G M 组里只能是派发表里的代码，读行和执行都不能用堆
+//
+//编译（在本文件夹里）：
+//  F="gcode_fuzz.cpp ../host/host.cpp ../../Lib/libraries/GCodeReader/src/GCodeReader.cpp ../../Lib/libraries/TinyStepper_28BYJ_48/src/TinyStepper_28BYJ_48.cpp ../../WallDrawGCode/WallDrawGCODE/gcode_parser.cpp ../../WallDrawGCode/WallDrawGCODE/QHStepper.cpp"
+//  I="-I../host -I../../Lib/libraries/GCodeReader/src -I../../Lib/libraries/TinyStepper_28BYJ_48/src -I../../WallDrawGCode/WallDrawGCODE"
+//  g++ -O2 $I $F -o gcode_fuzz                                                     测吞吐量
+//  g++ -g -O1 -fsanitize=address,undefined,float-cast-overflow -fno-sanitize-recover=all $I $F -o gcode_fuzz_asan   查越界、溢出
+//  clang++ -g -O1 -fsanitize=fuzzer,address,undefined -DGCODE_FUZZ_LIBFUZZER $I $F -o gcode_fuzz_lf                libFuzzer，main 由它提供
+//用法：
+//  gcode_fuzz [-n 变异次数] 文件或文件夹 ...       例：gcode_fuzz -n 200000 ../../NC seeds
+//  先把每个文件完整跑一遍，报告 行/秒 和 字节/秒；再从这些文件里随机截一段做变异，跑 -n 次（默认 100000）
+//  gcode_fuzz -b numbers 文件或文件夹 ...          每个数的时间：GCodeReader 对比 String 的 toFloat()
+//  gcode_fuzz -b lines 文件或文件夹 ...            每行的解析时间：GCodeReader 对比原来 String indexOf()/substring() 的解析
+//  测时间用 -O2 的版本；是电脑上的时间和 TSC 周期数，不是 AVR 上的，只看两种办法的比例
+//  检查不通过时打印原因，把出错的输入写到 crash.nc 后退出；libFuzzer 用 seeds 文件夹做初始语料
+
+#include <GCodeReader.h>
+#include "QH_Configuration.h"
+#include "gcode_parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <new>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <dirent.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC
+#endif
+
+//本来在 WallDrawGCODE.ino 里
+float destination[XYZ] = {0, 0, 0};
+float current_position[XYZ] = {0, 0, 0};
+float feedrate_mm_s = DEFAULT_FEEDRATE;
+long current_steps_M1 = 0, current_steps_M2 = 0;
+
+//数堆分配：读行和执行时必须是 0
+static long heap_allocs;
+void *operator new(size_t n) { heap_allocs++; void *p = malloc(n ? n : 1); if (!p) throw std::bad_alloc(); return p; }
+void *operator new[](size_t n) { heap_allocs++; void *p = malloc(n ? n : 1); if (!p) throw std::bad_alloc(); return p; }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+static const uint8_t *input;
+static size_t input_size;
+
+#define CHECK(c) do { if (!(c)) check_failed(__LINE__, #c); } while (0)
+static void check_failed(int line, const char *what)
+{
+  fprintf(stderr, "gcode_fuzz.cpp:%d check failed: %s\n", line, what);
+  FILE *f = fopen("crash.nc", "wb");
+  if (f) {
+    fwrite(input, 1, input_size, f);
+    fclose(f);
+    fprintf(stderr, "input written to crash.nc (%lu bytes)\n", (unsigned long)input_size);
+  }
+  abort();
+}
+
+//规划器桩
+static long planned_lines, planned_dwells;
+void plan_init() {}
+void plan_buffer_line(float x, float y, float fr_mm_s, uint8_t pen)
+{
+  CHECK(isfinite(x) && isfinite(y));
+  CHECK(isfinite(fr_mm_s) && fr_mm_s > 0);
+  CHECK(pen == PEN_UP || pen == PEN_DOWN);
+  planned_lines++;
+}
+void plan_buffer_dwell(float seconds) { CHECK(isfinite(seconds)); planned_dwells++; }
+void plan_flush() {}
+void plan_set_blend_tolerance(float tolerance) { CHECK(isfinite(tolerance) && tolerance >= 0); }
+block_t *plan_get_current_block() { return NULL; }
+float plan_get_exit_speed_sqr() { return 0; }
+block_t *plan_get_next_block() { return NULL; }
+void plan_discard_current_block() {}
+uint8_t plan_check_full_buffer() { return 0; }
+
+//派发表里每组允许的代码，-1 结尾
+static const int8_t group_codes[GCODE_GROUP_COUNT][6] = {
+  {0, 1, 2, 3, -1}, {4, 7, 28, 92, -1}, {17, -1}, {20, 21, -1}, {90, 91, -1}, {61, 64, -1}, {3, 4, 5, -1}, {2, 30, -1},
+};
+
+static bool code_allowed(uint8_t g, int8_t code)
+{
+  for (const int8_t *c = group_codes[g]; *c >= 0; c++)
+    if (*c == code) return true;
+  return false;
+}
+
+//每个输入都从开机状态开始，结果不受前一个输入影响
+static void reset_firmware()
+{
+  gcode = GCodeReader();
+  gcode.polyline(gcode_G7);
+  destination[X_AXIS] = destination[Y_AXIS] = destination[Z_AXIS] = 0;
+  current_position[X_AXIS] = current_position[Y_AXIS] = current_position[Z_AXIS] = 0;
+  feedrate_mm_s = DEFAULT_FEEDRATE;
+}
+
+static void check_line()
+{
+  for (uint8_t g = 0; g < GCODE_GROUP_COUNT; g++) {
+    int8_t code = gcode.group(g);
+    CHECK(code == -1 || code_allowed(g, code));
+  }
+  for (char l = 'A'; l <= 'Z'; l++) {
+    if (!gcode.seen(l)) continue;
+    CHECK(gcode.fixed(l) >= -GCODE_FIXED_MAX && gcode.fixed(l) <= GCODE_FIXED_MAX);
+    CHECK(isfinite(gcode.value(l)));
+  }
+  CHECK(gcode.motion() <= 3);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  input = data;
+  input_size = size;
+  reset_firmware();
+  long allocs = heap_allocs;
+  for (size_t i = 0; i < size; i++) {
+    if (!gcode.parse(data[i])) continue;
+    check_line();
+    uint8_t status = process_parsed_command();
+    CHECK(status != STATUS_OK || !gcode.error());
+    for (uint8_t a = 0; a < XYZ; a++) CHECK(isfinite(destination[a]) && isfinite(current_position[a]));
+  }
+  if (size && data[size - 1] != '\n' && gcode.parse('\n')) process_parsed_command();  //最后一行没有换行符
+  CHECK(heap_allocs == allocs);
+  return 0;
+}
+
+
+#ifndef GCODE_FUZZ_LIBFUZZER
+
+static std::vector<std::string> files;
+
+static void load(const std::string &path)
+{
+  struct stat st;
+  if (stat(path.c_str(), &st)) { perror(path.c_str()); exit(1); }
+  if (S_ISDIR(st.st_mode)) {
+    DIR *d = opendir(path.c_str());
+    while (struct dirent *e = readdir(d)) {
+      std::string name = e->d_name;
+      if (name.size() > 3 && (name.compare(name.size() - 3, 3, ".nc") == 0 || name.compare(name.size() - 3, 3, ".NC") == 0))
+        load(path + "/" + name);
+    }
+    closedir(d);
+    return;
+  }
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f) { perror(path.c_str()); exit(1); }
+  std::string s;
+  char buf[65536];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) s.append(buf, n);
+  fclose(f);
+  files.push_back(s);
+}
+
+//变异用的随机数和词典：G M 代码、字母、注释、大数、多余的小数位
+static uint64_t rng = 88172645463325252ULL;
+static uint32_t rnd()
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng >> 16;
+}
+
+static const char *dict[] = {
+  "G0", "G1", "G2", "G3", "G4", "G7", "G17", "G20", "G21", "G28", "G61", "G64", "G90", "G91", "G92", "G64.1",
+  "M2", "M3", "M4", "M5", "M30", "X", "Y", "Z", "I", "J", "R", "P", "F", "(", ")", ";", "/", "%", " ", "\t", "\r\n", "\n",
+  "-", "+", ".", "-0", "0.0001", "99999999", "2147483.647", "2147483.999", "-2147483.648", "1e5",
+};
+
+static void mutate(std::string &s)
+{
+  for (int k = 1 + rnd() % 8; k > 0; k--) {
+    size_t p = rnd() % (s.size() + 1);
+    switch (rnd() % 6) {
+      case 0: if (p < s.size()) s[p] ^= 1 << (rnd() % 8); break;
+      case 1: s.insert(p, 1, (char)rnd()); break;
+      case 2: if (p < s.size()) s.erase(p, 1 + rnd() % 8); break;
+      case 3: s.insert(p, dict[rnd() % (sizeof(dict) / sizeof(dict[0]))]); break;
+      case 4: if (!s.empty()) s.insert(p, s.substr(rnd() % s.size(), 1 + rnd() % 32)); break;
+      case 5: if (p < s.size()) s[p] = "0123456789.-+ "[rnd() % 14]; break;
+    }
+  }
+}
+
+//计时：跑 5 次取最快的，给出每项的纳秒数和 TSC 周期数
+static volatile float sink;
+
+template <class F> static void bench(const char *name, size_t items, long allocs_per_round, F run)
+{
+  double best_ns = 1e30, best_cycles = 1e30;
+  for (int r = 0; r < 5; r++) {
+#ifdef HAVE_RDTSC
+    uint64_t c0 = __rdtsc();
+#endif
+    auto t0 = std::chrono::steady_clock::now();
+    run();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+#ifdef HAVE_RDTSC
+    double cycles = __rdtsc() - c0;
+    if (cycles < best_cycles) best_cycles = cycles;
+#endif
+    if (ns < best_ns) best_ns = ns;
+  }
+  printf("  %-28s %7.1f ns", name, best_ns / items);
+#ifdef HAVE_RDTSC
+  printf(" %7.1f cycles", best_cycles / items);
+#endif
+  printf("  %5.2f heap allocations\n", (double)allocs_per_round / items);
+}
+
+//-b numbers：语料里字母后面的每个数
+//老办法是 substring() 切出来再 toFloat()；GCodeReader 是一个字节一个字节读，按 8 个字一行喂进去，字母、空格、行尾都算在里面
+static void bench_numbers()
+{
+  std::vector<String> words;  //"X-94.095" 这样带字母的字
+  std::string stream;
+  for (size_t i = 0; i < files.size(); i++) {
+    const std::string &f = files[i];
+    for (size_t p = 0; p < f.size(); p++) {
+      char c = f[p];
+      if (!((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'))) continue;
+      size_t e = p + 1;
+      while (e < f.size() && ((f[e] >= '0' && f[e] <= '9') || f[e] == '.' || f[e] == '-' || f[e] == '+')) e++;
+      if (e == p + 1) continue;
+      words.push_back(String(f.substr(p, e - p).c_str()));
+      p = e - 1;
+    }
+  }
+  if (words.empty()) { fprintf(stderr, "no numbers\n"); return; }
+  for (size_t i = 0; i < words.size(); i++) {
+    stream += 'X';
+    stream += words[i].c_str() + 1;
+    stream += (i % 8 == 7) ? '\n' : ' ';
+  }
+  stream += '\n';
+  size_t n = words.size();
+  printf("numbers: %lu from %lu files, host measurement\n", (unsigned long)n, (unsigned long)files.size());
+
+  long allocs;
+  auto to_float = [&]() { for (size_t i = 0; i < n; i++) sink = atof(words[i].c_str() + 1); };
+  to_float();
+  bench("toFloat()", n, 0, to_float);
+
+  auto substring_to_float = [&]() {
+    for (size_t i = 0; i < n; i++) sink = words[i].substring(1, words[i].length()).toFloat();
+  };
+  allocs = heap_allocs;
+  substring_to_float();
+  bench("substring().toFloat()", n, heap_allocs - allocs, substring_to_float);
+
+  auto reader = [&]() {
+    gcode = GCodeReader();
+    for (size_t i = 0; i < stream.size(); i++)
+      if (gcode.parse(stream[i])) sink = gcode.fixed('X');
+  };
+  allocs = heap_allocs;
+  reader();
+  bench("GCodeReader fixed-point", n, heap_allocs - allocs, reader);
+  CHECK(!gcode.error());
+}
+
+//原来 gcode_parser.cpp 的解析：按字节拼成 String，转大写，indexOf()/substring()/toFloat() 取数
+//只留取数，运动、打印都去掉；原来 get_command() 超过 35 个字节就截断，这里不截，每行都完整解析
+static float legacy_destination[XYZ], legacy_offset[2], legacy_r;
+
+static float legacy_word(const String &cmd, char letter, const char *ends)
+{
+  int start = cmd.indexOf(letter) + 1;
+  for (const char *e = ends; *e; e++)
+    if (cmd.indexOf(*e) > -1) return cmd.substring(start, cmd.indexOf(*e)).toFloat();
+  return cmd.substring(start, cmd.length()).toFloat();
+}
+
+static void legacy_parse(String &cmd)
+{
+  cmd.toUpperCase();
+  int code;
+  if (cmd.indexOf('G') > -1) code = cmd.substring(cmd.indexOf('G') + 1, cmd.indexOf('G') + 2).toInt();
+  else if (cmd.indexOf('M') > -1) { cmd.substring(cmd.indexOf('M') + 1, cmd.indexOf('M') + 2).toInt(); return; }
+  else return;
+  if (code > 3) return;
+  if (cmd.indexOf('X') > -1) legacy_destination[X_AXIS] = legacy_word(cmd, 'X', "YZS");
+  if (cmd.indexOf('Y') > -1) legacy_destination[Y_AXIS] = legacy_word(cmd, 'Y', "ZS");
+  if (code < 2) {
+    if (cmd.indexOf('Z') > -1) legacy_destination[Z_AXIS] = legacy_word(cmd, 'Z', "S");
+    return;
+  }
+  if (cmd.indexOf('R') > -1) legacy_r = legacy_word(cmd, 'R', "S");
+  else {
+    if (cmd.indexOf('I') > -1) legacy_offset[0] = legacy_word(cmd, 'I', "JS");
+    if (cmd.indexOf('J') > -1) legacy_offset[1] = legacy_word(cmd, 'J', "S");
+  }
+}
+
+//-b lines：每行解析出坐标要多久，两边都不做运动
+//GCodeReader 读完一行后取出和老解析一样的几个数
+static void bench_lines()
+{
+  std::vector<std::string> lines;
+  for (size_t i = 0; i < files.size(); i++) {
+    const std::string &f = files[i];
+    for (size_t p = 0; p < f.size();) {
+      size_t e = f.find('\n', p);
+      if (e == std::string::npos) e = f.size();
+      lines.push_back(f.substr(p, e - p));
+      p = e + 1;
+    }
+  }
+  size_t n = lines.size(), bytes = 0;
+  for (size_t i = 0; i < n; i++) bytes += lines[i].size() + 1;
+  printf("lines: %lu lines, %lu bytes from %lu files, host measurement\n", (unsigned long)n, (unsigned long)bytes, (unsigned long)files.size());
+
+  auto legacy = [&]() {
+    String cmd;
+    for (size_t i = 0; i < n; i++) {
+      for (const char *c = lines[i].c_str(); *c; c++) cmd += *c;
+      legacy_parse(cmd);
+      cmd = "";
+    }
+    sink = legacy_destination[X_AXIS] + legacy_destination[Y_AXIS] + legacy_offset[0] + legacy_r;
+  };
+  long allocs = heap_allocs;
+  legacy();
+  bench("String indexOf/substring", n, heap_allocs - allocs, legacy);
+
+  auto reader = [&]() {
+    float x = 0, y = 0, z = 0, i = 0, j = 0, r = 0;
+    gcode = GCodeReader();
+    for (size_t k = 0; k < n; k++) {
+      for (const char *c = lines[k].c_str(); *c; c++) gcode.parse(*c);
+      gcode.parse('\n');
+      if (gcode.seen('X')) x = gcode.axis('X', x);
+      if (gcode.seen('Y')) y = gcode.axis('Y', y);
+      if (gcode.seen('Z')) z = gcode.axis('Z', z);
+      if (gcode.seen('I')) i = gcode.length('I');
+      if (gcode.seen('J')) j = gcode.length('J');
+      if (gcode.seen('R')) r = gcode.length('R');
+    }
+    sink = x + y + z + i + j + r;
+  };
+  allocs = heap_allocs;
+  reader();
+  bench("GCodeReader", n, heap_allocs - allocs, reader);
+}
+
+int main(int argc, char **argv)
+{
+  long iterations = 100000;
+  const char *benchmark = NULL;
+  int a = 1;
+  for (; a + 1 < argc; a += 2) {
+    if (!strcmp(argv[a], "-n")) iterations = atol(argv[a + 1]);
+    else if (!strcmp(argv[a], "-b")) benchmark = argv[a + 1];
+    else break;
+  }
+  if (a == argc || (benchmark && strcmp(benchmark, "numbers") && strcmp(benchmark, "lines"))) {
+    fprintf(stderr, "usage: gcode_fuzz [-n iterations] [-b numbers|lines] file_or_dir ...\n");
+    return 1;
+  }
+  for (; a < argc; a++) load(argv[a]);
+  if (files.empty()) { fprintf(stderr, "no .nc files\n"); return 1; }
+  if (benchmark) {
+    if (!strcmp(benchmark, "numbers")) bench_numbers();
+    else bench_lines();
+    return 0;
+  }
+
+  //完整回放，测吞吐量
+  size_t bytes = 0;
+  unsigned long lines = 0;
+  double best = 1e30;
+  for (int r = 0; r < 3; r++) {  //取最快的一次，少受机器忙闲影响
+    bytes = lines = 0;
+    planned_lines = planned_dwells = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < files.size(); i++) {
+      LLVMFuzzerTestOneInput((const uint8_t *)files[i].data(), files[i].size());
+      bytes += files[i].size();
+      lines += gcode.lines();
+    }
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (s < best) best = s;
+  }
+  printf("replay: %lu files, %lu lines, %lu bytes, %.3f s: %.0f lines/s, %.1f MB/s\n",
+         (unsigned long)files.size(), lines, (unsigned long)bytes, best, lines / best, bytes / best / 1e6);
+  printf("        %ld lines and %ld dwells to the planner, sizeof(GCodeReader) = %lu bytes, no heap use\n",
+         planned_lines, planned_dwells, (unsigned long)sizeof(GCodeReader));
+
+  //变异：随机一个文件里截一段（最长 400 字节），做 1 到 8 次改动
+  bytes = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (long i = 0; i < iterations; i++) {
+    const std::string &f = files[rnd() % files.size()];
+    std::string s = f.substr(f.empty() ? 0 : rnd() % f.size(), 1 + rnd() % 400);
+    mutate(s);
+    LLVMFuzzerTestOneInput((const uint8_t *)s.data(), s.size());
+    bytes += s.size();
+  }
+  double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  printf("mutate: %ld inputs, %lu bytes, %.1f s, all checks passed\n", iterations, (unsigned long)bytes, s);
+  return 0;
+}
+
+#endif
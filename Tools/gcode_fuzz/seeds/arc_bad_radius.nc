@@ -0,0 +1,7 @@
+G0 X0 Y0
+G2 X10 Y0 R1
+G3 X0 Y0 R0.5
+G2 X10 Y10 R-3
+G2 X5 Y5
+G3 X20 Y0 I3 J0
+G2 X0 Y0 R10
@@ -0,0 +1,5 @@
+G20
+G1 F1
+G2 X0 Y0 I-2000000 J0
+G21
+G3 X0 Y0 I0.001 J0
@@ -0,0 +1,5 @@
+G1 X2147483.999 Y0
+G1 X-2147483.648
+G1 X2147483.6475 Y-2147483.6475
+G1 X1.000000000000009 Y99999999
+X10Y10
@@ -0,0 +1,6 @@
+G21 G90 M3
+G7 F600 X1 Y1 X2 X1 Y-1 Y-2
+G20 G7 X1
+G7 X.5Y-.5X99999999Y1X2Y2
+G91 G7 X-1
+M5
@@ -0,0 +1,16 @@
+(comment G1 X9)
+; whole line
+/G1 X5 Y5
+G1 X 1.5 (X7) Y2 ; Y8
+G1 X1 / Y2
+%
+N10 G1 X1
+X1E5
+G64.1 P1
+G1 X1 (unterminated
+G1 X2
+G4 P0.5
+G28 X5 Y5
+G92 X1 Y1
+M30
+G1 X3
\ No newline at end of file
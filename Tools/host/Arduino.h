@@ -0,0 +1,103 @@
+//电脑上跑固件用的 Arduino.h：只有固件和库里用到的那一点
+//时间是假的：每调一次 micros() 走 host_tick 微秒，delay() 直接加上，几分钟的图几秒钟跑完，结果每次都一样
+//串口：固件读的是 host_serial_input() 放进来的字节，打印的每一行交给 host_serial_line
+//引脚、舵机有钩子，测试程序用它记步进和抬落笔
+//用法：编译时 -I 这个文件夹，再加上 host.cpp
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "WString.h"
+
+#ifndef ARDUINO
+#define ARDUINO 100
+#endif
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH    1
+#define LOW     0
+#define INPUT   0
+#define OUTPUT  1
+#define A0      14
+#define PI      3.1415926535897932384626433832795
+
+#define PROGMEM
+#define F(s) s
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+
+#define sq(x) ((x) * (x))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define bitRead(value, bit)  (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit)   ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define noInterrupts()
+#define interrupts()
+
+#define SERIAL_RX_BUFFER_SIZE 64
+
+template <class A, class B> auto min(A a, B b) -> decltype(a + b) { return a < b ? a : b; }
+template <class A, class B> auto max(A a, B b) -> decltype(a + b) { return a > b ? a : b; }
+using ::abs;
+
+//假时间
+extern unsigned long host_time;  //现在的 micros()
+extern unsigned long host_tick;  //每调一次 micros() 走多少微秒，默认 4，和 16MHz 的 UNO 上一次轮询差不多
+unsigned long micros();
+unsigned long millis();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+extern void (*host_pin_hook)(uint8_t pin, uint8_t value);  //不为空时每次 digitalWrite 都调
+
+class Print
+{
+  public:
+    virtual size_t write(uint8_t c) = 0;
+    size_t print(const char *s);
+    size_t print(char c);
+    size_t print(int v, int base = 10);
+    size_t print(unsigned int v, int base = 10);
+    size_t print(long v, int base = 10);
+    size_t print(unsigned long v, int base = 10);
+    size_t print(double v, int digits = 2);
+    size_t println();
+    template <class T> size_t println(T v) { size_t n = print(v); return n + println(); }
+    template <class T> size_t println(T v, int f) { size_t n = print(v, f); return n + println(); }
+};
+
+class Stream : public Print
+{
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+class HardwareSerial : public Stream
+{
+  public:
+    void begin(unsigned long baud);
+    int available();
+    int read();
+    int peek();
+    size_t write(uint8_t c);
+    operator bool() { return true; }
+};
+extern HardwareSerial Serial;
+
+void host_serial_input(const char *data, size_t len);  //接在还没读的字节后面
+size_t host_serial_pending();                           //还有多少字节没读
+extern void (*host_serial_line)(const char *line);     //固件打印完一行（不含回车换行）时调
+
+#endif
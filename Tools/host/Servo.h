@@ -0,0 +1,20 @@
+//电脑上的舵机：只记角度，host_servo_hook 不为空时每次 write() 都调
+
+#ifndef HOST_SERVO_H
+#define HOST_SERVO_H
+
+#include <Arduino.h>
+
+extern void (*host_servo_hook)(int angle);
+
+class Servo
+{
+  public:
+    uint8_t attach(int pin) { (void)pin; return 1; }
+    void write(int angle) { value = angle; if (host_servo_hook) host_servo_hook(angle); }
+    int read() { return value; }
+  private:
+    int value = 0;
+};
+
+#endif
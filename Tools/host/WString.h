@@ -0,0 +1,79 @@
+//电脑上的 String：只有老的 G 代码解析用到的那几个函数
+//和 Arduino 的一样，每次 substring()、拼接都在堆上重新分配，用 new[]，测试程序能数出分配了几次
+
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+
+#include <stdlib.h>
+#include <string.h>
+
+class String
+{
+  public:
+    String(const char *s = "") { copy(s, strlen(s)); }
+    String(const String &s) { copy(s.buf, s.len); }
+    ~String() { delete[] buf; }
+    String &operator=(const String &s) { if (this != &s) { delete[] buf; copy(s.buf, s.len); } return *this; }
+    String &operator=(const char *s) { delete[] buf; copy(s, strlen(s)); return *this; }
+
+    String &operator+=(char c)
+    {
+      char *b = new char[len + 2];
+      memcpy(b, buf, len);
+      b[len++] = c;
+      b[len] = 0;
+      delete[] buf;
+      buf = b;
+      return *this;
+    }
+
+    unsigned int length() const { return len; }
+    const char *c_str() const { return buf; }
+    char charAt(unsigned int i) const { return i < len ? buf[i] : 0; }
+    char operator[](unsigned int i) const { return charAt(i); }
+
+    int indexOf(char c, unsigned int from = 0) const
+    {
+      if (from >= len) return -1;
+      const char *p = strchr(buf + from, c);
+      return p ? p - buf : -1;
+    }
+
+    String substring(unsigned int from, unsigned int to) const
+    {
+      if (from > to) { unsigned int t = from; from = to; to = t; }
+      if (to > len) to = len;
+      if (from > to) from = to;
+      String s(NULL, 0);
+      s.copy(buf + from, to - from);
+      return s;
+    }
+    String substring(unsigned int from) const { return substring(from, len); }
+
+    void toUpperCase() { for (char *p = buf; *p; p++) if (*p >= 'a' && *p <= 'z') *p -= 'a' - 'A'; }
+    void trim()
+    {
+      unsigned int a = 0, b = len;
+      while (a < b && (buf[a] == ' ' || buf[a] == '\t' || buf[a] == '\r' || buf[a] == '\n')) a++;
+      while (b > a && (buf[b - 1] == ' ' || buf[b - 1] == '\t' || buf[b - 1] == '\r' || buf[b - 1] == '\n')) b--;
+      memmove(buf, buf + a, b - a);
+      len = b - a;
+      buf[len] = 0;
+    }
+    long toInt() const { return atol(buf); }
+    float toFloat() const { return atof(buf); }
+
+  private:
+    String(const char *, int) { buf = NULL; len = 0; }
+    void copy(const char *s, unsigned int n)
+    {
+      buf = new char[n + 1];
+      memcpy(buf, s, n);
+      buf[n] = 0;
+      len = n;
+    }
+    char *buf;
+    unsigned int len;
+};
+
+#endif
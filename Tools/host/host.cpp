@@ -0,0 +1,89 @@
+//Arduino.h 里假时间、串口、引脚的实现
+#include <Arduino.h>
+#include <Servo.h>
+#include <stdio.h>
+#include <string>
+
+unsigned long host_time = 0;
+unsigned long host_tick = 4;
+void (*host_pin_hook)(uint8_t pin, uint8_t value) = NULL;
+void (*host_servo_hook)(int angle) = NULL;
+void (*host_serial_line)(const char *line) = NULL;
+
+unsigned long micros() { return host_time += host_tick; }
+unsigned long millis() { return micros() / 1000; }
+void delay(unsigned long ms) { host_time += ms * 1000; }
+void delayMicroseconds(unsigned int us) { host_time += us; }
+void yield() {}
+
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  if (host_pin_hook) host_pin_hook(pin, value);
+}
+
+
+size_t Print::print(const char *s)
+{
+  size_t n = 0;
+  while (*s) n += write(*s++);
+  return n;
+}
+
+size_t Print::print(char c) { return write(c); }
+size_t Print::print(int v, int base) { return print((long)v, base); }
+size_t Print::print(unsigned int v, int base) { return print((unsigned long)v, base); }
+
+size_t Print::print(long v, int base)
+{
+  char b[40];
+  snprintf(b, sizeof(b), base == 16 ? "%lx" : "%ld", v);
+  return print(b);
+}
+
+size_t Print::print(unsigned long v, int base)
+{
+  char b[40];
+  snprintf(b, sizeof(b), base == 16 ? "%lx" : "%lu", v);
+  return print(b);
+}
+
+size_t Print::print(double v, int digits)
+{
+  char b[64];
+  snprintf(b, sizeof(b), "%.*f", digits, v);
+  return print(b);
+}
+
+size_t Print::println() { return print("\r\n"); }
+
+
+static std::string serial_in, serial_out;
+static size_t serial_pos;
+
+void host_serial_input(const char *data, size_t len)
+{
+  if (serial_pos == serial_in.size()) {
+    serial_in.clear();
+    serial_pos = 0;
+  }
+  serial_in.append(data, len);
+}
+
+size_t host_serial_pending() { return serial_in.size() - serial_pos; }
+
+void HardwareSerial::begin(unsigned long) {}
+int HardwareSerial::available() { return serial_in.size() - serial_pos; }
+int HardwareSerial::read() { return serial_pos < serial_in.size() ? (uint8_t)serial_in[serial_pos++] : -1; }
+int HardwareSerial::peek() { return serial_pos < serial_in.size() ? (uint8_t)serial_in[serial_pos] : -1; }
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  if (c == '\n') {
+    if (host_serial_line) host_serial_line(serial_out.c_str());
+    serial_out.clear();
+  } else if (c != '\r') serial_out += (char)c;
+  return 1;
+}
+
+HardwareSerial Serial;
@@ -0,0 +1,325 @@
+//nc2bin：在电脑上把 .nc 的G代码转成 SD卡固件 WalldrawSDCard 能直接执行的二进制文件（格式见 GCodeBinary.h）
+//文件小很多，SD卡读得少，Arduino 上也不用再逐字解析
+//-g 输出的是文本G代码：连续的画线合成 G7 折线（见 GCodeReader.h），串口固件和 SD卡固件都认，串口发送一行只等一次 ok
+//
+//编译（Windows 可以用 MinGW 或 Visual Studio，Linux/Mac 用 g++ 或 clang++）：
+//  g++ -O2 -I../../Lib/libraries/GCodeReader/src nc2bin.cpp ../../Lib/libraries/GCodeReader/src/GCodeReader.cpp -o nc2bin
+//用法：
+//  nc2bin [-c] 输入.nc 输出.nc
+//  nc2bin -g [-l 行长] 输入.nc 输出.nc
+//  -c 带校验，SD卡读错时停下不乱画
+//  -g 输出 G7 折线的G代码；-l 每行最多多少字节，默认 63，Arduino 串口缓冲区 64 字节，按缓冲区空位发送的软件也能用
+//输出文件的名字照样用 1.nc 放到卡上，固件看文件头认出是二进制
+
+#include <GCodeReader.h>
+#include <GCodeBinary.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI  3.14159265358979323846
+#endif
+#define ARC_TOLERANCE  0.02  //圆弧切成短直线时允许的弦高误差 mm，和 WallDrawGCODE 一样
+
+static FILE *out;
+static bool with_check, text;
+static uint8_t crc;
+static long block_bytes, out_bytes, ops;
+static long max_line = 63, run_len, out_lines, points;  //-g：行长上限，正在写的 G7 行的长度（0 是没有），输出行数，点数
+
+static GCodeReader gcode(1);  //和 SD卡固件一样开机为 G1
+static double posx, posy, posz;  //程序里的当前位置 mm（机器坐标）
+static long qx, qy;              //已经写出去的位置，0.01mm
+static bool pen_down, pen_known;  //已经写出去的笔状态；开头还没写过
+static long feed = -1;           //已经写出去的 F
+
+static void put(uint8_t b)
+{
+  fputc(b, out);
+  crc = wdb_crc8(crc, b);
+  block_bytes++;
+  out_bytes++;
+}
+
+static void put_varint(uint32_t v)
+{
+  while (v >= 0x80) {
+    put((v & 0x7F) | 0x80);
+    v >>= 7;
+  }
+  put(v);
+}
+
+//每个操作开始前看要不要先放校验点
+static void op(uint8_t code)
+{
+  if (with_check && block_bytes >= WDB_CHECK_BLOCK) {
+    uint8_t c = crc;
+    fputc(WDB_OP_CHECK, out);
+    fputc(c, out);
+    out_bytes += 2;
+    crc = 0;
+    block_bytes = 0;
+  }
+  put(code);
+  ops++;
+}
+
+//-g 文本输出：结束正在写的 G7 行
+static void end_run()
+{
+  if (!run_len) return;
+  fputc('\n', out);
+  out_bytes++;
+  out_lines++;
+  run_len = 0;
+}
+
+static void put_line(const char *s)
+{
+  end_run();
+  out_bytes += fprintf(out, "%s\n", s);
+  out_lines++;
+}
+
+//0.01mm 的整数写成 mm，去掉末尾的 0；short 时 0.35 写成 .35
+static const char *mm(long v, bool short_form)
+{
+  static char buf[2][24];
+  static int n;
+  char *s = buf[n ^= 1], *p = s;
+  unsigned long a = v < 0 ? -v : v;
+  if (v < 0) *p++ = '-';
+  if (a / 100 || !short_form || a == 0) p += sprintf(p, "%lu", a / 100);
+  if (a % 10) sprintf(p, ".%02lu", a % 100);
+  else if (a % 100) sprintf(p, ".%lu", a % 100 / 10);
+  return s;
+}
+
+static void pen(bool down)
+{
+  if (pen_known && down == pen_down) return;
+  pen_known = true;
+  pen_down = down;
+  if (text) put_line(down ? "M3" : "M5");
+  else op(down ? WDB_OP_PEN_DOWN : WDB_OP_PEN_UP);
+}
+
+//-g：画线的点接到 G7 行后面，超过行长另起一行；F 有变化时也另起一行，写在 G7 后面
+static void text_point(long dx, long dy)
+{
+  static long line_feed = -1;  //已经写出去的 F
+  static bool x_only;          //这一行上一个点只有 X，还没结束
+  char pt[64], *p = pt;
+  //读的时候点到 Y 才结束：只有 Y 的点跟在只有 X 的点后面会被并成一个点，要补 X0
+  if (dx || (x_only && run_len)) p += sprintf(p, "X%s", mm(dx, true));
+  if (dy) p += sprintf(p, "Y%s", mm(dy, true));
+  x_only = !dy;
+  long len = p - pt;
+  if (run_len + len > max_line || feed != line_feed) end_run();
+  if (!run_len) {
+    run_len = fprintf(out, "G7");
+    if (feed != line_feed && feed > 0) run_len += fprintf(out, "F%ld", feed);
+    line_feed = feed;
+    out_bytes += run_len;
+  }
+  fputs(pt, out);
+  run_len += len;
+  out_bytes += len;
+  points++;
+}
+
+static void move(double x, double y, bool rapid)
+{
+  long nx = lround(x * WDB_UNITS_PER_MM), ny = lround(y * WDB_UNITS_PER_MM);
+  posx = x;
+  posy = y;
+  if (nx == qx && ny == qy) return;
+  if (text) {
+    if (rapid) {
+      char s[64];
+      sprintf(s, "G0X%sY%s", mm(nx, false), mm(ny, false));  //空走用绝对坐标，G7 增量的累计误差到这里清掉
+      put_line(s);
+    } else text_point(nx - qx, ny - qy);
+  } else {
+    op(rapid ? WDB_OP_RAPID : WDB_OP_LINE);
+    put_varint(wdb_zigzag(nx - qx));
+    put_varint(wdb_zigzag(ny - qy));
+  }
+  qx = nx;
+  qy = ny;
+}
+
+//圆弧切成弦高不超过 ARC_TOLERANCE 的直线；参数不对返回 false，和 WallDrawGCODE 一样检查
+static bool arc(double x, double y, bool clockwise)
+{
+  double cx, cy;
+  if (gcode.seen('R')) {
+    double r = gcode.length('R'), dx = x - posx, dy = y - posy, d = sqrt(dx * dx + dy * dy);
+    if (d == 0) return false;
+    double h2 = r * r - d * d / 4;
+    if (h2 < 0) return false;
+    double e = (clockwise ^ (r < 0)) ? -1 : 1, h = sqrt(h2);
+    cx = (posx + x) / 2 - e * h * dy / d;
+    cy = (posy + y) / 2 + e * h * dx / d;
+  } else {
+    if (!gcode.seen('I') && !gcode.seen('J')) return false;
+    cx = posx + (gcode.seen('I') ? gcode.length('I') : 0);
+    cy = posy + (gcode.seen('J') ? gcode.length('J') : 0);
+    double r = hypot(posx - cx, posy - cy), delta = fabs(hypot(x - cx, y - cy) - r);
+    if (delta > 0.5 || (delta > 0.005 && delta > 0.001 * r)) return false;
+  }
+  double radius = hypot(posx - cx, posy - cy),
+         a0 = atan2(posy - cy, posx - cx),
+         travel = atan2(y - cy, x - cx) - a0;
+  if (travel < 0) travel += 2 * M_PI;
+  if (clockwise) travel -= 2 * M_PI;
+  if (travel == 0 && x == posx && y == posy) travel = 2 * M_PI;
+  long segments = 1;
+  if (radius > ARC_TOLERANCE)
+    segments = (long)ceil(fabs(travel) * radius / (2 * sqrt(ARC_TOLERANCE * (2 * radius - ARC_TOLERANCE))));
+  if (segments < 1) segments = 1;
+  for (long i = 1; i < segments; i++) {
+    double a = a0 + travel * i / segments;
+    move(cx + cos(a) * radius, cy + sin(a) * radius, false);
+  }
+  move(x, y, false);
+  return true;
+}
+
+//F：二进制里是一个操作，-g 时记下来，写在下一个 G7 行里
+static void feed_word()
+{
+  if (gcode.seen('F') && gcode.value('F') > 0) {
+    long f = lround(gcode.length('F'));
+    if (f != feed && !text) {
+      op(WDB_OP_FEED);
+      put_varint(f);
+    }
+    feed = f;
+  }
+}
+
+//输入里的 G7 折线：分词器读到一个点就调一次
+static void polyline_point(float dx, float dy)
+{
+  feed_word();
+  move(posx + dx, posy + dy, false);
+}
+
+//和 WalldrawSDCard 的 nc() 同样的顺序执行一行
+static bool line()
+{
+  if (gcode.error()) return false;
+
+  feed_word();
+
+  switch (gcode.group(GCODE_GROUP_SPINDLE)) {
+    case 3:
+    case 4: pen(true);  break;
+    case 5: pen(false); break;
+  }
+
+  switch (gcode.group(GCODE_GROUP_NON_MODAL)) {
+    case 4:
+      if (gcode.seen('P') && gcode.value('P') > 0) {
+        if (text) {
+          char s[32];
+          sprintf(s, "G4P%g", gcode.value('P'));
+          put_line(s);
+        } else {
+          op(WDB_OP_DWELL);
+          put_varint(lround(gcode.value('P') * 1000));
+        }
+      }
+      break;
+    case 28:
+      pen(false);
+      if (gcode.seen('X') || gcode.seen('Y'))
+        move(gcode.seen('X') ? gcode.axis('X', posx) : posx, gcode.seen('Y') ? gcode.axis('Y', posy) : posy, true);
+      move(0, 0, true);
+      break;
+    case 92:
+      gcode.set_origin('X', posx);
+      gcode.set_origin('Y', posy);
+      break;
+  }
+
+  bool ok = true;
+  if (gcode.group(GCODE_GROUP_NON_MODAL) != 28 && gcode.group(GCODE_GROUP_NON_MODAL) != 92 && gcode.group(GCODE_GROUP_NON_MODAL) != 7) {
+    if (gcode.seen('Z')) {
+      posz = gcode.axis('Z', posz);
+      pen(posz <= 0);
+    }
+    if (gcode.has_axis() && (gcode.seen('X') || gcode.seen('Y') || gcode.motion() >= 2)) {
+      double x = gcode.seen('X') ? gcode.axis('X', posx) : posx,
+             y = gcode.seen('Y') ? gcode.axis('Y', posy) : posy;
+      if (gcode.motion() >= 2) ok = arc(x, y, gcode.motion() == 2);
+      else move(x, y, gcode.motion() == 0);
+    }
+  }
+
+  if (gcode.group(GCODE_GROUP_STOP) >= 0) {
+    pen(false);
+    gcode.program_end();
+  }
+  return ok;
+}
+
+int main(int argc, char **argv)
+{
+  int a = 1;
+  for (; a < argc && argv[a][0] == '-' && argv[a][1]; a++) {
+    if (!strcmp(argv[a], "-c")) with_check = true;
+    else if (!strcmp(argv[a], "-g")) text = true;
+    else if (!strcmp(argv[a], "-l") && a + 1 < argc) max_line = atol(argv[++a]);
+    else break;
+  }
+  if (argc - a != 2 || max_line < 32) {
+    fprintf(stderr, "usage: nc2bin [-c] input.nc output.nc\n"
+                    "       nc2bin -g [-l max_line_bytes] input.nc output.nc\n");
+    return 1;
+  }
+  FILE *in = fopen(argv[a], "rb");
+  if (!in) { perror(argv[a]); return 1; }
+  out = fopen(argv[a + 1], "wb");
+  if (!out) { perror(argv[a + 1]); return 1; }
+
+  gcode.polyline(polyline_point);
+  if (text) {
+    put_line("G21G90");  //输出都是毫米、绝对坐标
+  } else {
+    fputs("WDB", out);
+    fputc(WDB_VERSION, out);
+    fputc(with_check ? WDB_FLAG_CHECK : 0, out);
+    out_bytes = 5;
+  }
+  //WallDrawGCODE 开机 Z=0 是落笔，不能靠执行的一方猜：开头先明确抬笔
+  pen(false);
+
+  long in_bytes = 0, bad = 0;
+  int c, last = '\n';  //空文件不算一行
+  while ((c = fgetc(in)) != EOF) {
+    in_bytes++;
+    last = c;
+    if (gcode.parse(c) && !line()) {
+      bad++;
+      fprintf(stderr, "line %lu skipped\n", (unsigned long)gcode.lines());
+    }
+  }
+  if (last != '\n' && gcode.parse('\n') && !line()) bad++;  //最后一行没有换行符；有的话再送一个就多出一个空行
+  if (text) end_run();
+  else op(WDB_OP_END);
+  fclose(in);
+  fclose(out);
+
+  if (text)
+    printf("%lu lines, %ld bytes -> %ld lines, %ld bytes (%.1fx), %ld G7 points, %ld lines skipped\n",
+           (unsigned long)gcode.lines(), in_bytes, out_lines, out_bytes, out_bytes ? (double)in_bytes / out_bytes : 0.0, points, bad);
+  else
+    printf("%lu lines, %ld bytes -> %ld bytes (%.1fx), %ld ops, %ld lines skipped\n",
+           (unsigned long)gcode.lines(), in_bytes, out_bytes, out_bytes ? (double)in_bytes / out_bytes : 0.0, ops, bad);
+  return 0;
+}
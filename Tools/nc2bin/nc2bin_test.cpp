@@ -0,0 +1,105 @@
+//nc2bin_test：nc2bin 输出的开头必须先明确抬笔，不能靠执行的一方开机时的笔状态（WallDrawGCODE 开机 Z=0 是落笔）
+//-g：G21G90 之后第一个笔命令或运动命令必须是 M5；二进制（带不带 -c）：文件头后的第一个操作必须是 WDB_OP_PEN_UP
+//每个输入每种输出都在子进程（fork，Linux/Mac）里跑一遍 nc2bin 的 main()，全局状态每次都是新的
+//
+//编译（在本文件夹里）：
+//  g++ -O2 -I../../Lib/libraries/GCodeReader/src nc2bin_test.cpp ../../Lib/libraries/GCodeReader/src/GCodeReader.cpp -o nc2bin_test
+//用法：
+//  nc2bin_test [文件.nc ...]       例：nc2bin_test ../../NC/*.nc
+//  程序里的几个小例子（开头没有笔命令、M3 开头、Z 开头）总是先跑；不通过时打印原因，返回 1
+
+#define main nc2bin_main
+#include "nc2bin.cpp"
+#undef main
+
+#include <string>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static const char *cases[] = {
+  "G0X10Y10\nG1X20Y10\n",     //没有笔命令：笔应该一直是抬的
+  "M3\nG1X5Y5\nM5\n",         //第一句就落笔
+  "G1Z0\nG1X5\nG0Z5\n",       //用 Z 落笔
+  "G0Z5\nG0X1Y1\nG1Z-1\nG1X2\n",
+};
+
+static const char *tmp_in = "nc2bin_test_in.nc", *tmp_out = "nc2bin_test_out.nc";
+
+static bool convert(const char *input, const char *flag)
+{
+  pid_t pid = fork();
+  if (pid == 0) {
+    if (!freopen("/dev/null", "w", stdout)) _exit(2);
+    char *argv[5];
+    int argc = 0;
+    argv[argc++] = (char *)"nc2bin";
+    if (flag) argv[argc++] = (char *)flag;
+    argv[argc++] = (char *)input;
+    argv[argc++] = (char *)tmp_out;
+    argv[argc] = NULL;
+    _exit(nc2bin_main(argc, argv));
+  }
+  int status;
+  return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+//G21G90 之后第一个 M3/M5/G0/G7/G4 行
+static std::string first_command()
+{
+  FILE *f = fopen(tmp_out, "r");
+  if (!f) return "";
+  char buf[256];
+  std::string first;
+  bool header = fgets(buf, sizeof(buf), f) && !strcmp(buf, "G21G90\n");
+  while (header && first.empty() && fgets(buf, sizeof(buf), f))
+    if (buf[0] == 'M' || buf[0] == 'G') first = std::string(buf, strcspn(buf, "\n"));
+  fclose(f);
+  return header ? first : "(no G21G90)";
+}
+
+static int first_op()
+{
+  FILE *f = fopen(tmp_out, "rb");
+  if (!f) return -1;
+  int c = -1;
+  for (int i = 0; i < 6; i++) c = fgetc(f);
+  fclose(f);
+  return c;
+}
+
+static int check(const char *input, const char *name)
+{
+  int failed = 0;
+  if (!convert(input, "-g")) { printf("%s: nc2bin -g failed\n", name); return 1; }
+  std::string g = first_command();
+  if (g != "M5") { printf("%s: -g starts with %s, not M5\n", name, g.c_str()); failed = 1; }
+  const char *flags[] = {NULL, "-c"};
+  for (int i = 0; i < 2; i++) {
+    if (!convert(input, flags[i])) { printf("%s: nc2bin %s failed\n", name, flags[i] ? flags[i] : ""); return 1; }
+    int op = first_op();
+    if (op != WDB_OP_PEN_UP) {
+      printf("%s: binary%s starts with op %d, not WDB_OP_PEN_UP\n", name, flags[i] ? " -c" : "", op);
+      failed = 1;
+    }
+  }
+  return failed;
+}
+
+int main(int argc, char **argv)
+{
+  int failed = 0, n = 0;
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++, n++) {
+    FILE *f = fopen(tmp_in, "w");
+    if (!f) { perror(tmp_in); return 1; }
+    fputs(cases[i], f);
+    fclose(f);
+    char name[32];
+    snprintf(name, sizeof(name), "case %lu", (unsigned long)i);
+    failed |= check(tmp_in, name);
+  }
+  for (int a = 1; a < argc; a++, n++) failed |= check(argv[a], argv[a]);
+  remove(tmp_in);
+  remove(tmp_out);
+  printf("%d inputs, %s\n", n, failed ? "FAILED" : "all start with the pen up");
+  return failed;
+}
@@ -0,0 +1,164 @@
+//planbench：规划器 QHPlanner.cpp 每加一块的开销，增量重新规划（只算 block_buffer_planned 之后的块）对比每次全部重算
+//规划器原样编译进来，段生成器换成桩：缓冲区满了就把最老的块扔掉，记下它的进入速度，不切段不走步
+//全部重算：每加一块前把 block_buffer_planned 放回 tail，前后两遍就从正在执行的块算起，和改成增量之前一样
+//两种方式扔掉的每一块进入速度必须一样（按位比较），不一样时打印第一处并返回 1
+//
+//编译（在本文件夹里），PLANBENCH_DEPTH 是 BLOCK_BUFFER_SIZE，必须是 2 的幂，不给就用 QH_Configuration.h 里的：
+//  D=../../WallDrawGCode/WallDrawGCODE; L=../../Lib/libraries
+//  for n in 8 16 32 64; do g++ -O2 -DPLANBENCH_DEPTH=$n -I../host -I$D -I$L/GCodeReader/src planbench.cpp $L/GCodeReader/src/GCodeReader.cpp -o planbench_$n; done
+//用法：
+//  planbench 文件或 spiral ...       例：planbench_16 "../../NC/BMW 100x100mm.nc" spiral "../../NC/蒙娜丽莎 150x200.nc"
+//  spiral 是程序里生成的阿基米德螺线 r = 5 + 2θ，θ 每次加 0.01，20000 条短弦，落笔一笔画完，转角都很小
+//  G代码用 GCodeReader 读：G0 按 RAPID_FEEDRATE，其它按 DEFAULT_FEEDRATE，Z>0 抬笔；圆弧只取终点，G7 折线每个点一块
+//输出每个文件：加进规划器的块数，两种方式每加一块访问的块数（前后两遍 while 循环的次数）和时间（纳秒，5 次取最快）
+//时间是电脑上的，只看比例；访问的块数和机器无关
+
+#include "QH_Configuration.h"
+#ifdef PLANBENCH_DEPTH
+#undef BLOCK_BUFFER_SIZE
+#define BLOCK_BUFFER_SIZE PLANBENCH_DEPTH
+#endif
+#include "QHPlanner.cpp"
+
+#include <GCodeReader.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+//本来在 WallDrawGCODE.ino 和 QHStepper.cpp 里
+float current_position[XYZ] = {0, 0, 0};
+
+void IK(float x, float y, long &target_steps_m1, long &target_steps_m2)
+{
+  target_steps_m1 = lround(HYPOT(x - X_MIN_POS, y - Y_MIN_POS) / DEFAULT_XY_MM_PER_STEP);
+  target_steps_m2 = lround(HYPOT(x - X_MAX_POS, y - Y_MIN_POS) / DEFAULT_XY_MM_PER_STEP);
+}
+
+//plan_buffer_block() 等缓冲区空位时调；主程序加块前已经腾出位置，这里不会被调到
+void stepper_idle()
+{
+  plan_discard_current_block();
+}
+
+struct move_t {
+  float x, y, fr_mm_s;
+  uint8_t pen;
+};
+
+static std::vector<move_t> moves;
+static float gx, gy, gz = PEN_UP_Z;
+static float feed;
+
+static void add_move()
+{
+  moves.push_back({gx, gy, feed, gz > 0 ? (uint8_t)PEN_UP : (uint8_t)PEN_DOWN});
+}
+
+static void polyline_point(float dx, float dy)
+{
+  gx += dx;
+  gy += dy;
+  add_move();
+}
+
+static bool load(const char *name)
+{
+  moves.clear();
+  gx = gy = 0;
+  gz = PEN_UP_Z;
+  if (!strcmp(name, "spiral")) {
+    moves.push_back({5, 0, RAPID_FEEDRATE, PEN_UP});
+    for (int i = 0; i < 20000; i++) {
+      float theta = i * 0.01, r = 5 + 2 * theta;
+      moves.push_back({r * cosf(theta), r * sinf(theta), DEFAULT_FEEDRATE, PEN_DOWN});
+    }
+    return true;
+  }
+  FILE *f = fopen(name, "rb");
+  if (!f) { perror(name); return false; }
+  GCodeReader gcode(1);
+  gcode.polyline(polyline_point);
+  int c;
+  while ((c = fgetc(f)) != EOF) {
+    feed = DEFAULT_FEEDRATE;
+    if (!gcode.parse(c) || gcode.error() || gcode.group(GCODE_GROUP_NON_MODAL) == 7 || !gcode.has_axis()) continue;
+    if (gcode.seen('X')) gx = gcode.axis('X', gx);
+    if (gcode.seen('Y')) gy = gcode.axis('Y', gy);
+    if (gcode.seen('Z')) gz = gcode.axis('Z', gz);
+    if (gcode.motion() == 0) feed = RAPID_FEEDRATE;
+    add_move();
+  }
+  fclose(f);
+  return true;
+}
+
+//把全部运动放进规划器；满了先扔掉最老的块；entry 不为空时记下每块扔掉时的进入速度
+static void replay(bool naive, long &visits, std::vector<float> *entry)
+{
+  current_position[X_AXIS] = current_position[Y_AXIS] = 0;
+  plan_init();
+  visits = 0;
+  for (size_t i = 0; i < moves.size(); i++) {
+    if (plan_check_full_buffer()) {
+      if (entry) entry->push_back(plan_get_current_block()->entry_speed_sqr);
+      plan_discard_current_block();
+    }
+    if (naive) block_buffer_planned = block_buffer_tail;
+    uint8_t head = block_buffer_head, planned = block_buffer_planned;
+    plan_buffer_line(moves[i].x, moves[i].y, moves[i].fr_mm_s, moves[i].pen);
+    //planner_recalculate() 从 planned 到新的 head 共 n 块：往回一遍 n-2 次，往前一遍 n-1 次
+    if (block_buffer_head != head) {
+      long n = (block_buffer_head - planned) & (BLOCK_BUFFER_SIZE - 1);
+      if (n >= 2) visits += 2 * n - 3;
+    }
+  }
+  while (plan_get_current_block()) {
+    if (entry) entry->push_back(plan_get_current_block()->entry_speed_sqr);
+    plan_discard_current_block();
+  }
+}
+
+static double best_ns(bool naive)
+{
+  double best = 1e30;
+  long visits;
+  for (int r = 0; r < 5; r++) {
+    auto t0 = std::chrono::steady_clock::now();
+    replay(naive, visits, NULL);
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (s < best) best = s;
+  }
+  return best * 1e9;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2) {
+    fprintf(stderr, "usage: planbench file.nc|spiral ...\n");
+    return 1;
+  }
+  printf("BLOCK_BUFFER_SIZE %d: blocks visited and ns per appended block, full recompute / incremental\n", BLOCK_BUFFER_SIZE);
+  int failed = 0;
+  for (int a = 1; a < argc; a++) {
+    if (!load(argv[a])) return 1;
+    long naive_visits, visits;
+    std::vector<float> naive_entry, entry;
+    replay(true, naive_visits, &naive_entry);
+    replay(false, visits, &entry);
+    size_t blocks = naive_entry.size(), i = 0;
+    while (i < blocks && i < entry.size() && !memcmp(&naive_entry[i], &entry[i], sizeof(float))) i++;
+    if (i < blocks || entry.size() != blocks) {
+      printf("%s: entry speed of block %lu differs: %g / %g\n", argv[a], (unsigned long)i,
+             i < blocks ? naive_entry[i] : -1.0f, i < entry.size() ? entry[i] : -1.0f);
+      failed = 1;
+      continue;
+    }
+    double naive_ns = best_ns(true), ns = best_ns(false);
+    printf("  %-40s %7lu blocks  visited %6.1f / %4.1f  time %6.1f / %5.1f ns  entry speeds identical\n", argv[a],
+           (unsigned long)blocks, (double)naive_visits / blocks, (double)visits / blocks, naive_ns / blocks, ns / blocks);
+  }
+  return failed;
+}
@@ -0,0 +1,2 @@
+G1Z0
+G1X80Y0
@@ -0,0 +1,239 @@
+//wallsim：在电脑上跑串口固件（WallDrawGCODE），记下笔每一步后的位置，再用吊笔的摆模型算晃动
+//G代码一行一行从串口发，等到 ok 或 error 再发下一行，和上位机一样；时间是 host 层的假时间
+//每次电机线圈引脚变化时用 stepper_position() 取执行器走到的位置，得到笔的真实轨迹（按步，不是规划的目标）
+//摆模型：笔架是挂在绳上的摆，固有频率 f0，阻尼比 ZETA；悬挂点按轨迹移动，算笔架相对悬挂点的偏离
+//
+//编译（在本文件夹里），加 -DS_CURVE_ACCELERATION 为 S 形加减速，不加为梯形：
+//  D=../../WallDrawGCode/WallDrawGCODE; L=../../Lib/libraries
+//  F="wallsim.cpp $D/gcode_parser.cpp $D/QHPlanner.cpp $D/QHStepper.cpp $L/GCodeReader/src/GCodeReader.cpp $L/TinyStepper_28BYJ_48/src/TinyStepper_28BYJ_48.cpp ../host/host.cpp"
+//  I="-I../host -I$L/GCodeReader/src -I$L/TinyStepper_28BYJ_48/src -I$D"
+//  g++ -O2 -w -DARDUINO=100 $I $F -o wallsim_tr
+//  g++ -O2 -w -DARDUINO=100 -DS_CURVE_ACCELERATION $I $F -o wallsim_sc
+//用法：
+//  wallsim [-s 步进记录文件] [-j 微秒] G代码文件       例：wallsim_tr move80.nc；wallsim_sc -j 5000 move80.nc
+//  -j：每发一行，主循环卡住这么久（假时间往前跳），模拟 AVR 上解析和规划一行的耗时，看卡住之后补步会不会太密
+//  move80.nc 是落笔后按默认速度 20mm/s 横走 80mm，move80_f30.nc 是 F1800（30mm/s，按 MAX_FEEDRATE 约 29.8 走）
+//  步进记录每行是 秒 X Y，可以拿去画图
+//输出：运动用时、峰值加速度（位置平滑后求导），每个 f0 的最大偏离、停下时的余摆、余摆降到 SETTLE_MM 以下要多久
+//还检查每个电机相邻两步的最小间隔，小于 MIN_STEP_INTERVAL（电机会丢步）时打印并返回 1
+
+#include <Arduino.h>
+byte get_command();
+void report_status();
+#include "WallDrawGCODE.ino"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#define ZETA       0.05   //摆的阻尼比
+#define SETTLE_MM  0.05   //余摆小于这个算停稳 mm
+#define TAIL_S     5.0    //运动结束后再算几秒
+#define SMOOTH_MS  100    //求加速度前位置的平滑窗口 毫秒，小了步距台阶的噪声盖过加速度
+#define IDLE_US    1000000UL  //全部发完、队列空、这么久没走步，认为画完了
+
+static const float f0s[] = {2, 3, 4};  //摆的固有频率 Hz，绳长约 6 到 25 厘米
+
+struct sample_t {
+  double t;  //秒
+  float x, y;
+};
+
+static std::vector<sample_t> steps;
+static float last_x, last_y;
+static unsigned long last_pin_time;
+static int waiting;  //已发出、还没回 ok 的行数
+
+//每个电机走一步先写 in1，用它记下每一步的时刻；引脚见 stepper_init()
+static const uint8_t in1_pins[2] = {11, 7};
+static unsigned long last_step_us[2];
+static bool stepped[2];
+static unsigned long min_gap_us[2] = {~0UL, ~0UL};
+static double min_gap_t[2];  //最小间隔出现的时刻 秒
+
+//takeStep() 先写线圈引脚再改步数，所以这里取到的是前面各步走完的位置，时间是前一次写引脚的时刻
+static void on_pin(uint8_t pin, uint8_t)
+{
+  for (int m = 0; m < 2; m++) {
+    if (pin != in1_pins[m]) continue;
+    if (stepped[m] && host_time - last_step_us[m] < min_gap_us[m]) {
+      min_gap_us[m] = host_time - last_step_us[m];
+      min_gap_t[m] = host_time / 1e6;
+    }
+    stepped[m] = true;
+    last_step_us[m] = host_time;
+  }
+  float x, y;
+  stepper_position(x, y);
+  if (x != last_x || y != last_y) {
+    steps.push_back({last_pin_time / 1e6, x, y});
+    last_x = x;
+    last_y = y;
+  }
+  last_pin_time = host_time;
+}
+
+static void on_line(const char *line)
+{
+  if (!strcmp(line, "ok") || !strncmp(line, "error:", 6)) waiting--;
+  else if (!strncmp(line, "error", 5)) fprintf(stderr, "%s\n", line);
+}
+
+//按时间线性插值
+static void position_at(double t, size_t &i, float &x, float &y)
+{
+  while (i + 1 < steps.size() && steps[i + 1].t <= t) i++;
+  if (t <= steps[0].t || i + 1 >= steps.size()) {
+    x = t <= steps[0].t ? steps[0].x : steps.back().x;
+    y = t <= steps[0].t ? steps[0].y : steps.back().y;
+    return;
+  }
+  const sample_t &a = steps[i], &b = steps[i + 1];
+  double u = (t - a.t) / (b.t - a.t);
+  x = a.x + (b.x - a.x) * u;
+  y = a.y + (b.y - a.y) * u;
+}
+
+//位置 1 毫秒取样，SMOOTH_MS 滑动平均两次，再求两次导；只是估计：平滑会削低梯形的加速度突变，步距台阶又会加一点噪声
+static void smooth(std::vector<double> &v, int k)
+{
+  std::vector<double> s(v.size());
+  for (size_t j = 0; j < v.size(); j++) {
+    double sum = 0;
+    for (int d = -k / 2; d < k - k / 2; d++) sum += v[min(max((long)j + d, 0L), (long)v.size() - 1)];
+    s[j] = sum / k;
+  }
+  v.swap(s);
+}
+
+static double peak_acceleration()
+{
+  const double dt = 1e-3;
+  double t0 = steps[0].t, t1 = steps.back().t;
+  size_t n = (size_t)((t1 - t0) / dt) + 2 * SMOOTH_MS + 2, i = 0;
+  std::vector<double> px(n), py(n);
+  for (size_t j = 0; j < n; j++) {
+    float x, y;
+    position_at(t0 + ((double)j - SMOOTH_MS) * dt, i, x, y);
+    px[j] = x;
+    py[j] = y;
+  }
+  for (int r = 0; r < 2; r++) { smooth(px, SMOOTH_MS); smooth(py, SMOOTH_MS); }
+  double peak = 0;
+  for (size_t j = 1; j + 1 < n; j++)
+    peak = max(peak, hypot(px[j + 1] - 2 * px[j] + px[j - 1], py[j + 1] - 2 * py[j] + py[j - 1]) / (dt * dt));
+  return peak;
+}
+
+//悬挂点按轨迹走，笔架 p 受回复力 -w^2(p-X) 和阻尼 -2ζw(v-V)；0.2 毫秒一步
+static void pendulum(float f0, double &swing, double &residual, double &settle)
+{
+  const double dt = 2e-4;
+  double w = 2 * M_PI * f0, t0 = steps[0].t, t_end = steps.back().t;
+  size_t n = (size_t)((t_end - t0 + TAIL_S) / dt), i = 0, period = (size_t)(1 / f0 / dt);
+  size_t end = (size_t)((t_end - t0) / dt), last_big = 0;
+  float X, Y;
+  position_at(t0, i, X, Y);
+  double px = X, py = Y, vpx = 0, vpy = 0, x_prev = X, y_prev = Y;
+  swing = residual = 0;
+  for (size_t j = 0; j < n; j++) {
+    position_at(t0 + j * dt, i, X, Y);
+    double vx = (X - x_prev) / dt, vy = (Y - y_prev) / dt;
+    x_prev = X;
+    y_prev = Y;
+    double apx = -w * w * (px - X) - 2 * ZETA * w * (vpx - vx);
+    double apy = -w * w * (py - Y) - 2 * ZETA * w * (vpy - vy);
+    vpx += apx * dt;
+    vpy += apy * dt;
+    px += vpx * dt;
+    py += vpy * dt;
+    double amp = hypot(px - X, py - Y);
+    swing = max(swing, amp);
+    if (j >= end && j < end + period) residual = max(residual, amp);  //停下后第一个周期里的最大偏离
+    if (amp > SETTLE_MM) last_big = j;
+  }
+  //最后一个周期的包络还在 SETTLE_MM 以上的时刻
+  settle = last_big + 1 > end + period ? (last_big + 1 - period - end) * dt : 0;
+}
+
+int main(int argc, char **argv)
+{
+  const char *step_file = NULL;
+  unsigned long stall_us = 0;
+  int a = 1;
+  while (a + 2 < argc && argv[a][0] == '-') {
+    if (!strcmp(argv[a], "-s")) step_file = argv[a + 1];
+    else if (!strcmp(argv[a], "-j")) stall_us = strtoul(argv[a + 1], NULL, 10);
+    else break;
+    a += 2;
+  }
+  if (a + 1 != argc) {
+    fprintf(stderr, "usage: wallsim [-s steps.log] [-j stall_us] file.nc\n");
+    return 1;
+  }
+  FILE *f = fopen(argv[a], "r");
+  if (!f) { perror(argv[a]); return 1; }
+  std::vector<std::string> lines;
+  char buf[256];
+  while (fgets(buf, sizeof(buf), f)) lines.push_back(buf);
+  fclose(f);
+
+  host_serial_line = on_line;
+  setup();
+  stepper_position(last_x, last_y);
+  float start_x = last_x, start_y = last_y;
+  host_pin_hook = on_pin;
+
+  size_t next = 0;
+  unsigned long last_step = host_time;
+  size_t logged = 0;
+  while (next < lines.size() || waiting > 0 || host_time - last_step < IDLE_US) {
+    if (waiting == 0 && next < lines.size()) {
+      std::string &l = lines[next++];
+      if (l.empty() || l[l.size() - 1] != '\n') l += '\n';
+      host_serial_input(l.data(), l.size());
+      waiting++;
+      host_time += stall_us;
+    }
+    loop();
+    if (steps.size() != logged) { logged = steps.size(); last_step = host_time; }
+  }
+  on_pin(0, 0);  //最后一步
+  host_pin_hook = NULL;
+  if (steps.size() < 2) { fprintf(stderr, "no motion\n"); return 1; }
+  //第一步之前笔在起点，和第二步的间隔当作第一步的用时
+  steps.insert(steps.begin(), sample_t{2 * steps[0].t - steps[1].t, start_x, start_y});
+
+  if (step_file) {
+    FILE *o = fopen(step_file, "w");
+    if (!o) { perror(step_file); return 1; }
+    for (size_t i = 0; i < steps.size(); i++) fprintf(o, "%.6f %.4f %.4f\n", steps[i].t - steps[0].t, steps[i].x, steps[i].y);
+    fclose(o);
+  }
+
+#ifdef S_CURVE_ACCELERATION
+  const char *mode = "S-curve";
+#else
+  const char *mode = "trapezoid";
+#endif
+  printf("%s: %lu lines, %.2f s moving, %lu steps, peak acceleration %.1f mm/s^2 (DEFAULT_ACCELERATION %d)\n",
+         mode, (unsigned long)lines.size(), steps.back().t - steps[0].t, (unsigned long)steps.size() - 1,
+         peak_acceleration(), DEFAULT_ACCELERATION);
+  for (size_t k = 0; k < sizeof(f0s) / sizeof(f0s[0]); k++) {
+    double swing, residual, settle;
+    pendulum(f0s[k], swing, residual, settle);
+    printf("  pendulum %g Hz: max swing %.2f mm, residual %.2f mm, settles below %.2f mm in %.1f s\n",
+           f0s[k], swing, residual, SETTLE_MM, settle);
+  }
+  int failed = 0;
+  for (int m = 0; m < 2; m++) {
+    if (!stepped[m] || min_gap_us[m] == ~0UL) continue;
+    printf("  M%d: shortest step interval %lu us at %.6f s (MIN_STEP_INTERVAL %d)\n", m + 1, min_gap_us[m],
+           min_gap_t[m] - steps[0].t, MIN_STEP_INTERVAL);
+    if (min_gap_us[m] < MIN_STEP_INTERVAL) failed = 1;
+  }
+  if (failed) printf("FAILED: steps closer than MIN_STEP_INTERVAL\n");
+  return failed;
+}
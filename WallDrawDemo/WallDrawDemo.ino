@@ -19,7 +19,8 @@
 #define SPOOL_CIRC      (SPOOL_DIAMETER * 3.1416)  //线轴周长 35*3.14=109.956
 #define TPS             (SPOOL_CIRC / STEPS_PER_TURN)  //步进电机步距，最小分辨率 每步线绳被拉动的距离  0.053689mm
 
-#define step_delay      1   //步进电机每步的等候时间 （微妙）
+#define step_delay      2240   //步进电机每步的间隔时间（微秒），28BYJ-48 约450步/秒
+#define SEGMENTS_PER_SECOND  50   //长线每秒运动切成的小段数，走得快的线每段长，每秒算逆解的次数固定
 #define TPD             300   //转弯等待时间（毫秒），由于惯性笔会继续运动，暂定等待笔静止再运动。
 
 
@@ -50,6 +51,8 @@ static long laststep1, laststep2; //当前线长度 记录笔位置
 //抬笔舵机的角度参数  具体数值要看摆臂的安放位置，需要调节
 #define PEN_UP_ANGLE    70  //抬笔
 #define PEN_DOWN_ANGLE  85  //落笔
+#define SERVO_MS_PER_DEGREE  2    //舵机每转1度的时间（毫秒），SG90 约0.1秒转60度
+#define PEN_SETTLE_TIME      30   //落笔后笔尖在纸上稳定的时间（毫秒）
 //上面是需要调节的参数 =============================================
 
 
@@ -73,6 +76,7 @@ static float feed_rate = 0;
 
 // pen state 笔状态（抬笔，落笔）.
 static int ps;
+static unsigned long pen_ready_ms;  //舵机预计转到位的时刻，到这之前电机不动
 
 /*以下为G代码通讯参数 */
 #define BAUD            (115200)    //串口速率，用于传输G代码或调试 可选9600，57600，115200 或其他常用速率
@@ -133,17 +137,18 @@ void pen_state(int pen_st) {
         //Serial.println("Pen up");
       }
   pen.write(ps);
+  pen_ready_ms = millis() + abs(PEN_DOWN_ANGLE - PEN_UP_ANGLE) * SERVO_MS_PER_DEGREE + (pen_st==PEN_DOWN ? PEN_SETTLE_TIME : 0);
 }
 
 
-//
+//抬笔落笔不在这里等：记下舵机转到位的时刻，下一段走步前 pen_wait() 再等，中间算下一个点的时间不浪费
 void pen_down()
 {
   if (ps==PEN_UP_ANGLE)
   {
     ps=PEN_DOWN_ANGLE;
     pen.write(ps);
-    delay(TPD);
+    pen_ready_ms = millis() + abs(PEN_DOWN_ANGLE - PEN_UP_ANGLE) * SERVO_MS_PER_DEGREE + PEN_SETTLE_TIME;
   }
 
 }
@@ -154,11 +159,18 @@ void pen_up()
   {
     ps=PEN_UP_ANGLE;
     pen.write(ps);
+    pen_ready_ms = millis() + abs(PEN_DOWN_ANGLE - PEN_UP_ANGLE) * SERVO_MS_PER_DEGREE;
   }
 
   
 }
 
+//等舵机转到位
+static void pen_wait()
+{
+  while ((long)(millis() - pen_ready_ms) < 0);
+}
+
 //------------------------------------------------------------------------------
 //调试代码串口输出机器状态
 void where() {
@@ -234,33 +246,35 @@ void moveto(float x,float y) {
   long ad2=abs(d2);
   int dir1=d1>0 ? M1_REEL_IN : M1_REEL_OUT;
   int dir2=d2>0 ? M2_REEL_IN : M2_REEL_OUT;
-  long over=0;
-  long i;
-
-
-  if(ad1>ad2) {
-    for(i=0;i<ad1;++i) {
-      
-      m1.moveRelativeInSteps(dir1);
-      over+=ad2;
-      if(over>=ad1) {
-        over-=ad1;
-        m2.moveRelativeInSteps(dir2);
-      }
-      delayMicroseconds(step_delay);
-     }
-  } 
-  else {
-    for(i=0;i<ad2;++i) {
-      m2.moveRelativeInSteps(dir2);
-      over+=ad1;
-      if(over>=ad2) {
-        over-=ad2;
-        m1.moveRelativeInSteps(dir1);
-      }
-      delayMicroseconds(step_delay);
+  //两个电机各用一个DDA，在同一时间轴上按各自的理想时刻走步：
+  //n 步均匀分布在整段时间 total 内，第 k 步在 (k+0.5)*total/n，次轴不再紧跟主轴的步
+  unsigned long total=max(ad1,ad2)*step_delay;
+  unsigned long p1=0,r1=0,e1=0,t1=0;
+  unsigned long p2=0,r2=0,e2=0,t2=0;
+  if(ad1) { p1=total/ad1; r1=total%ad1; t1=p1/2; }
+  if(ad2) { p2=total/ad2; r2=total%ad2; t2=p2/2; }
+  long i1=0,i2=0;
+  if(ad1 || ad2) pen_wait();
+  unsigned long start=micros();
+
+  while(i1<ad1 || i2<ad2) {
+    unsigned long now=micros()-start;
+    if(i1<ad1 && now>=t1) {
+      m1.takeStep(dir1);
+      i1++;
+      t1+=p1;
+      e1+=r1;
+      if(e1>=(unsigned long)ad1) { e1-=ad1; t1++; }
+    }
+    if(i2<ad2 && now>=t2) {
+      m2.takeStep(dir2);
+      i2++;
+      t2+=p2;
+      e2+=r2;
+      if(e2>=(unsigned long)ad2) { e2-=ad2; t2++; }
     }
   }
+  while(micros()-start<total) ;  //等到整段结束，下一段的第一步才不会提前
 
   laststep1=l1;
   laststep2=l2;
@@ -270,6 +284,12 @@ void moveto(float x,float y) {
   
 }
 
+//------------------------------------------------------------------------------
+//切割长线时每小段的长度：按时间切，每秒 SEGMENTS_PER_SECOND 段，至少一步
+static float segment_length() {
+  return max(TPS, TPS * 1000000.0 / step_delay / SEGMENTS_PER_SECOND);
+}
+
 //------------------------------------------------------------------------------
 //长距离移动会走圆弧轨迹，所以将长线切割成短线保持直线形态
 static void line_safe(float x,float y) {
@@ -279,13 +299,14 @@ static void line_safe(float x,float y) {
 
   float len=sqrt(dx*dx+dy*dy);
   
-  if(len<=TPS) {
+  float seg=segment_length();
+  if(len<=seg) {
     moveto(x,y);
     return;
   }
   
   // too long!
-  long pieces=floor(len/TPS);
+  long pieces=floor(len/seg);
   float x0=posx;
   float y0=posy;
   float a;
@@ -382,7 +403,6 @@ void box(float xx,float yy,float dx,float dy)
     pen_up();
     line_safe(xx , yy);
     pen_down();
-   delay(TPD);
      line_safe(xx + dx, yy);
    delay(TPD);
      line_safe(xx + dx, yy+ dy);
@@ -0,0 +1,262 @@
+#include "QHPlanner.h"
+#include "QHStepper.h"
+
+//规划器环形缓冲区 tail 是段生成器正在切割的块，它的进入速度已经定了，重新规划不能改
+static block_t block_buffer[BLOCK_BUFFER_SIZE];
+static uint8_t block_buffer_head = 0;  //下一个空位
+static uint8_t block_buffer_tail = 0;  //最老的块
+static uint8_t block_buffer_planned = 0;  //它和它之前的块速度已经是最优，重新规划只算它之后的块
+#define BLOCK_NEXT(i) (((i) + 1) & (BLOCK_BUFFER_SIZE - 1))
+#define BLOCK_PREV(i) (((i) + BLOCK_BUFFER_SIZE - 1) & (BLOCK_BUFFER_SIZE - 1))
+
+static float pl_position[XY];          //最后一块的终点
+static long pl_steps[XY];              //最后一块终点的电机步数
+static float pl_previous_unit_vec[XY]; //最后一块的方向，用来算转角
+static float pl_previous_nominal_speed_sqr;
+static uint8_t pl_pen;                 //最后一块的笔状态
+
+//G64 P 连续路径模式：画线时偏离路径不超过 P 的中间点合并掉，转角按偏差 P 过弯
+static float pl_blend_tolerance;           //0 表示关闭（G61）
+static float pl_blend_pending[XY];         //最后收到还没放入规划器的点
+static float pl_blend_fr_mm_s;
+static bool pl_blend_has_pending;
+static float pl_blend_points[BLEND_MAX_POINTS][XY];  //已合并掉的点，新的直线要离它们都不超过 P
+static uint8_t pl_blend_count;
+
+void plan_init(){
+  block_buffer_head = block_buffer_tail = block_buffer_planned = 0;
+  pl_position[X_AXIS] = current_position[X_AXIS];
+  pl_position[Y_AXIS] = current_position[Y_AXIS];
+  IK(pl_position[X_AXIS], pl_position[Y_AXIS], pl_steps[X_AXIS], pl_steps[Y_AXIS]);
+  pl_previous_unit_vec[X_AXIS] = pl_previous_unit_vec[Y_AXIS] = 0;
+  pl_previous_nominal_speed_sqr = 0;
+  pl_pen = PEN_UP;
+  pl_blend_tolerance = 0;
+  pl_blend_has_pending = false;
+  pl_blend_count = 0;
+}
+
+block_t *plan_get_current_block(){
+  if(block_buffer_head == block_buffer_tail) return NULL;
+  return &block_buffer[block_buffer_tail];
+}
+
+//当前块的退出速度就是下一块的进入速度，没有下一块则必须停下
+float plan_get_exit_speed_sqr(){
+  uint8_t next = BLOCK_NEXT(block_buffer_tail);
+  if(next == block_buffer_head) return 0;
+  return block_buffer[next].entry_speed_sqr;
+}
+
+//正在切割的块之后的一块，没有则返回NULL
+block_t *plan_get_next_block(){
+  uint8_t next = BLOCK_NEXT(block_buffer_tail);
+  if(block_buffer_head == block_buffer_tail || next == block_buffer_head) return NULL;
+  return &block_buffer[next];
+}
+
+void plan_discard_current_block(){
+  if(block_buffer_head != block_buffer_tail){
+    if(block_buffer_tail == block_buffer_planned) block_buffer_planned = BLOCK_NEXT(block_buffer_tail);
+    block_buffer_tail = BLOCK_NEXT(block_buffer_tail);
+  }
+}
+
+uint8_t plan_check_full_buffer(){
+  return BLOCK_NEXT(block_buffer_head) == block_buffer_tail;
+}
+
+//前瞻：从最新的块往回算，保证每块都能在后面的距离内减速到0；
+//再从 block_buffer_planned 往前算，保证每块的进入速度都能从前一块加速得到
+//只算 block_buffer_planned 之后的块：一块的进入速度已经到了最大值，或者受前一块加速限制，
+//以后再加块也不会变，planned 就移到这里，每加一块通常只算最后几块，不随缓冲区长度增加
+static void planner_recalculate(){
+  uint8_t block_index = BLOCK_PREV(block_buffer_head);
+  if(block_index == block_buffer_planned) return;  //只有一块可以规划
+
+  block_t *next;
+  block_t *current = &block_buffer[block_index];
+  current->entry_speed_sqr = min(current->max_entry_speed_sqr, 2 * current->acceleration * current->millimeters);
+
+  block_index = BLOCK_PREV(block_index);
+  while(block_index != block_buffer_planned){
+    next = current;
+    current = &block_buffer[block_index];
+    block_index = BLOCK_PREV(block_index);
+    if(current->entry_speed_sqr != current->max_entry_speed_sqr){
+      current->entry_speed_sqr = min(current->max_entry_speed_sqr,
+                                     next->entry_speed_sqr + 2 * current->acceleration * current->millimeters);
+    }
+  }
+
+  next = &block_buffer[block_buffer_planned];
+  block_index = BLOCK_NEXT(block_buffer_planned);
+  while(block_index != block_buffer_head){
+    current = next;
+    next = &block_buffer[block_index];
+    if(current->entry_speed_sqr < next->entry_speed_sqr){
+      float entry_speed_sqr = current->entry_speed_sqr + 2 * current->acceleration * current->millimeters;
+      if(entry_speed_sqr < next->entry_speed_sqr){
+        next->entry_speed_sqr = entry_speed_sqr;  //受加速限制，以后不会变
+        block_buffer_planned = block_index;
+      }
+    }
+    if(next->entry_speed_sqr == next->max_entry_speed_sqr) block_buffer_planned = block_index;  //已经最大
+    block_index = BLOCK_NEXT(block_index);
+  }
+}
+
+//把一条直线加入规划器，缓冲区满时等段生成器腾出位置
+//主循环在缓冲区满时不读新的G代码，正常不会在这里等
+static void plan_buffer_block(float x, float y, float fr_mm_s, uint8_t pen){
+  long target_steps[XY];
+  IK(x, y, target_steps[X_AXIS], target_steps[Y_AXIS]);
+  float delta_x, delta_y, millimeters;
+  if(pen == PEN_UP){
+    //抬笔空走不用走直线：两电机在线长空间里直线插补，不用切小段算逆解
+    //长度按走得多的那根线算，速度上限就是电机的上限
+    delta_x = (target_steps[X_AXIS] - pl_steps[X_AXIS]) * DEFAULT_XY_MM_PER_STEP;
+    delta_y = (target_steps[Y_AXIS] - pl_steps[Y_AXIS]) * DEFAULT_XY_MM_PER_STEP;
+    millimeters = max(fabs(delta_x), fabs(delta_y));
+  } else {
+    delta_x = x - pl_position[X_AXIS];
+    delta_y = y - pl_position[Y_AXIS];
+    millimeters = HYPOT(delta_x, delta_y);
+  }
+  if(millimeters < DEFAULT_XY_MM_PER_STEP * 0.5){
+    if(pen == pl_pen) return;  //不到半步，忽略
+    //原地抬笔落笔：长度为0的块只带笔状态，位置不变
+    x = pl_position[X_AXIS];
+    y = pl_position[Y_AXIS];
+    target_steps[X_AXIS] = pl_steps[X_AXIS];
+    target_steps[Y_AXIS] = pl_steps[Y_AXIS];
+    delta_x = delta_y = millimeters = 0;
+  }
+
+  while(plan_check_full_buffer()) stepper_idle();
+
+  block_t *block = &block_buffer[block_buffer_head];
+  block->target[X_AXIS] = x;
+  block->target[Y_AXIS] = y;
+  block->target_steps[X_AXIS] = target_steps[X_AXIS];
+  block->target_steps[Y_AXIS] = target_steps[Y_AXIS];
+  block->millimeters = millimeters;
+#ifdef S_CURVE_ACCELERATION
+  block->acceleration = DEFAULT_ACCELERATION * 8.0 / 15;  //S形曲线中点加速度是平均值的15/8倍，按平均值规划，最大值不超过设定
+#else
+  block->acceleration = DEFAULT_ACCELERATION;
+#endif
+  block->nominal_speed_sqr = sq(min(fr_mm_s, (float)MAX_FEEDRATE));
+  block->pen = pen;
+  block->dwell = 0;
+
+  float inverse_length = millimeters > 0 ? 1.0 / HYPOT(delta_x, delta_y) : 0;
+  float unit_vec[XY] = { delta_x * inverse_length, delta_y * inverse_length };
+
+  //转角速度（junction deviation）：以允许偏离 JUNCTION_DEVIATION 的圆弧过弯，
+  //向心加速度不超过 acceleration 时的速度  v^2 = a * r,  r = d * sin(θ/2) / (1 - sin(θ/2))
+  if(block_buffer_head == block_buffer_tail || pl_previous_nominal_speed_sqr == 0 || pen != pl_pen){
+    block->max_entry_speed_sqr = 0;  //从静止开始，抬笔落笔前也要先停下
+  } else {
+    float junction_cos_theta = -unit_vec[X_AXIS] * pl_previous_unit_vec[X_AXIS]
+                               -unit_vec[Y_AXIS] * pl_previous_unit_vec[Y_AXIS];
+    float junction_speed_sqr;
+    if(junction_cos_theta > 0.999999){
+      junction_speed_sqr = 0;  //原路折返
+    } else if(junction_cos_theta < -0.999999){
+      junction_speed_sqr = block->nominal_speed_sqr;  //直线
+    } else {
+      float sin_theta_d2 = SQRT(0.5 * (1.0 - junction_cos_theta));
+      float deviation = max((float)JUNCTION_DEVIATION, pl_blend_tolerance);
+      junction_speed_sqr = block->acceleration * deviation * sin_theta_d2 / (1.0 - sin_theta_d2);
+    }
+    block->max_entry_speed_sqr = min(junction_speed_sqr, min(block->nominal_speed_sqr, pl_previous_nominal_speed_sqr));
+  }
+  block->entry_speed_sqr = 0;
+
+  pl_previous_unit_vec[X_AXIS] = unit_vec[X_AXIS];
+  pl_previous_unit_vec[Y_AXIS] = unit_vec[Y_AXIS];
+  pl_previous_nominal_speed_sqr = millimeters > 0 ? block->nominal_speed_sqr : 0;  //原地抬落笔后下一块从静止开始
+  pl_position[X_AXIS] = x;
+  pl_position[Y_AXIS] = y;
+  pl_steps[X_AXIS] = target_steps[X_AXIS];
+  pl_steps[Y_AXIS] = target_steps[Y_AXIS];
+  pl_pen = pen;
+
+  block_buffer_head = BLOCK_NEXT(block_buffer_head);
+  planner_recalculate();
+}
+
+//G4 暂停：排在已缓冲的运动后面，前面的块走完停下，原地等 seconds 秒再走后面的块
+void plan_buffer_dwell(float seconds){
+  plan_flush();
+  if(seconds <= 0) return;
+  while(plan_check_full_buffer()) stepper_idle();
+
+  block_t *block = &block_buffer[block_buffer_head];
+  block->target[X_AXIS] = pl_position[X_AXIS];
+  block->target[Y_AXIS] = pl_position[Y_AXIS];
+  block->target_steps[X_AXIS] = pl_steps[X_AXIS];
+  block->target_steps[Y_AXIS] = pl_steps[Y_AXIS];
+  block->millimeters = 0;
+  block->entry_speed_sqr = block->max_entry_speed_sqr = block->nominal_speed_sqr = 0;
+  block->acceleration = DEFAULT_ACCELERATION;
+  block->pen = pl_pen;
+  block->dwell = seconds;
+  pl_previous_nominal_speed_sqr = 0;
+
+  block_buffer_head = BLOCK_NEXT(block_buffer_head);
+  planner_recalculate();
+}
+
+//点 (px,py) 到线段 a-b 的距离
+static float segment_distance(float px, float py, const float (&a)[XY], const float (&b)[XY]){
+  float vx = b[X_AXIS] - a[X_AXIS], vy = b[Y_AXIS] - a[Y_AXIS];
+  float wx = px - a[X_AXIS], wy = py - a[Y_AXIS];
+  float len_sqr = HYPOT2(vx, vy);
+  float t = len_sqr > 0 ? constrain((wx * vx + wy * vy) / len_sqr, 0, 1) : 0;
+  return HYPOT(wx - t * vx, wy - t * vy);
+}
+
+//把合并后留下的点放入规划器
+void plan_flush(){
+  if(!pl_blend_has_pending) return;
+  pl_blend_has_pending = false;
+  pl_blend_count = 0;
+  plan_buffer_block(pl_blend_pending[X_AXIS], pl_blend_pending[Y_AXIS], pl_blend_fr_mm_s, PEN_DOWN);
+}
+
+//G64 P：tolerance 为路径允许偏差 mm；G61：0，精确路径
+void plan_set_blend_tolerance(float tolerance){
+  plan_flush();
+  pl_blend_tolerance = tolerance;
+}
+
+//G代码的直线先到这里：连续路径模式下画线的点先留着，
+//下一个点来了看从上一块终点直接走过去是否离中间的点都不超过 P，是就合并，密集的小线段变成少数几块长线
+void plan_buffer_line(float x, float y, float fr_mm_s, uint8_t pen){
+  //抬笔空走和落笔后第一段不合并，落笔事件照常排进规划器
+  if(pl_blend_tolerance == 0 || pen != PEN_DOWN || pl_pen != PEN_DOWN){
+    plan_flush();
+    plan_buffer_block(x, y, fr_mm_s, pen);
+    return;
+  }
+  if(pl_blend_has_pending){
+    float end[XY] = { x, y };
+    bool merge = fr_mm_s == pl_blend_fr_mm_s && pl_blend_count < BLEND_MAX_POINTS
+                 && segment_distance(pl_blend_pending[X_AXIS], pl_blend_pending[Y_AXIS], pl_position, end) <= pl_blend_tolerance;
+    for(uint8_t i = 0; merge && i < pl_blend_count; i++)
+      merge = segment_distance(pl_blend_points[i][X_AXIS], pl_blend_points[i][Y_AXIS], pl_position, end) <= pl_blend_tolerance;
+    if(merge){
+      pl_blend_points[pl_blend_count][X_AXIS] = pl_blend_pending[X_AXIS];
+      pl_blend_points[pl_blend_count][Y_AXIS] = pl_blend_pending[Y_AXIS];
+      pl_blend_count++;
+    } else {
+      plan_flush();
+    }
+  }
+  pl_blend_pending[X_AXIS] = x;
+  pl_blend_pending[Y_AXIS] = y;
+  pl_blend_fr_mm_s = fr_mm_s;
+  pl_blend_has_pending = true;
+}
@@ -0,0 +1,30 @@
+#ifndef QH_PLANNER_H
+#define QH_PLANNER_H
+
+#include "QH_Configuration.h"
+
+//规划块：一条直线G代码，速度单位 mm/s，存平方避免开方
+typedef struct {
+  float target[XY];             //终点坐标 mm（起点是上一块的终点）
+  long target_steps[XY];        //终点两电机的绝对步数
+  float millimeters;            //直线长度 mm
+  float entry_speed_sqr;        //规划的进入速度
+  float max_entry_speed_sqr;    //转角和前后两块速度允许的最大进入速度
+  float nominal_speed_sqr;      //匀速段速度
+  float acceleration;           //加速度 mm/s^2
+  uint8_t pen;                  //这条线的笔状态 PEN_UP / PEN_DOWN，长度为0的块只抬落笔
+  float dwell;                  //长度为0的块原地等待的秒数（G4）
+} block_t;
+
+void plan_init();
+void plan_buffer_line(float x, float y, float fr_mm_s, uint8_t pen);
+void plan_buffer_dwell(float seconds);
+void plan_flush();
+void plan_set_blend_tolerance(float tolerance);
+block_t *plan_get_current_block();
+float plan_get_exit_speed_sqr();
+block_t *plan_get_next_block();
+void plan_discard_current_block();
+uint8_t plan_check_full_buffer();
+
+#endif
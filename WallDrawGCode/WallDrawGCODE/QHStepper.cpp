@@ -1,8 +1,11 @@
 #include "QHStepper.h"
+#include "QHPlanner.h"
 #include <TinyStepper_28BYJ_48.h>		//步进电机的库 如果没有该lib请按Ctrl+Shift+I 从 库管理器中搜索 Stepper_28BYJ_48，并安装
+#include <Servo.h>
 
 TinyStepper_28BYJ_48 m1; //(7,8,9,10);  //M1 L步进电机   in1~4端口对应UNO  7 8 9 10
 TinyStepper_28BYJ_48 m2; //(2,3,5,6);  //M2 R步进电机   in1~4端口对应UNO 2 3 5 6
+Servo pen_servo;
 
 
 
@@ -14,11 +17,32 @@ void IK(float x,float y,long &target_steps_m1, long &target_steps_m2) {
   target_steps_m2 = round(sqrt(dx*dx+dy*dy) / DEFAULT_XY_MM_PER_STEP);
 }
 
+//执行器已经走完的步数，'?' 报告的位置由它算；current_steps_M1/M2 是段生成器切到哪里了，比它超前
+static long executed_steps_m1, executed_steps_m2;
+
+//段生成器的状态
+static struct {
+  block_t *block;        //正在切割的块
+  float start[XY];       //块的起点
+  long start_steps[XY];  //块起点的电机步数，抬笔空走按步数插补
+  float unit_vec[XY];    //块的方向
+  float mm_complete;     //已切割的长度
+  float speed;           //当前速度 mm/s，跨块延续
+  uint8_t pen;           //已放入段队列的笔状态
+  float pen_seconds;     //上次落笔命令之后已放入段队列的时长，够 PEN_DOWN_TIME 就不再累加
+#ifdef S_CURVE_ACCELERATION
+  float ramp_v0, ramp_dv; //正在进行的加减速：起始速度和速度变化量
+  float ramp_time;        //加减速总时长 秒，0表示匀速
+  float ramp_t;           //已进行的时间
+  float ramp_mm;          //开始加减速时在块内的位置
+#endif
+} prep;
+
 void stepper_init(){
   long target_steps_m1,target_steps_m2;
   IK(0, 0, target_steps_m1, target_steps_m2);
-  current_steps_M1 = target_steps_m1;
-  current_steps_M2 = target_steps_m2;
+  current_steps_M1 = executed_steps_m1 = target_steps_m1;
+  current_steps_M2 = executed_steps_m2 = target_steps_m2;
 
   m1.connectToPins(11,10,9,8); //M1 L步进电机   in1~4端口对应UNO  7 8 9 10
   m2.connectToPins(7,6,5,4);  //M2 R步进电机   in1~4端口对应UNO 2 3 5 6
@@ -27,95 +51,428 @@ void stepper_init(){
   m2.setSpeedInStepsPerSecond(10000);
   m2.setAccelerationInStepsPerSecondPerSecond(100000);
   //舵机初始化
+  pen_servo.attach(PEN_SERVO_PIN);
+  pen_servo.write(PEN_UP_ANGLE);
+  prep.pen = PEN_UP;
+  prep.pen_seconds = PEN_DOWN_TIME * 0.001;
+
+  prep.start[X_AXIS] = current_position[X_AXIS];
+  prep.start[Y_AXIS] = current_position[Y_AXIS];
+  plan_init();
+}
+
+//步进段队列 单生产者（主循环）单消费者（执行器）的无锁环形队列
+//head 只由生产者修改，tail 只由消费者修改，执行器以后移入定时器中断也不需要关中断
+static segment_t segment_buffer[SEGMENT_BUFFER_SIZE];
+static volatile uint8_t segment_buffer_head = 0;  //下一个空位
+static volatile uint8_t segment_buffer_tail = 0;  //下一个待执行的段
+#define SEGMENT_NEXT(i) (((i) + 1) & (SEGMENT_BUFFER_SIZE - 1))
+
+//队列中等待执行的段数
+uint8_t segment_buffer_count(){
+  return (segment_buffer_head - segment_buffer_tail) & (SEGMENT_BUFFER_SIZE - 1);
+}
+
+static uint8_t pending_pen = PEN_NO_CHANGE;  //还没放入段队列的舵机动作，随下一段放入
+static float pending_seconds = 0;            //不到一步的小段的时间，加到下一段上
+
+static void segment_buffer_push(segment_t &seg){
+  seg.pen = pending_pen;
+  pending_pen = PEN_NO_CHANGE;
+  uint8_t next_head = SEGMENT_NEXT(segment_buffer_head);
+  while(next_head == segment_buffer_tail) stepper_run();  //队列满，等执行器取走一段
+  segment_buffer[segment_buffer_head] = seg;
+  segment_buffer_head = next_head;
+}
+
+//单轴DDA：n 步均匀分布在整段时间内，第 k 步在 (k+0.5)*T/n 时刻
+//两个电机各用一个，共用段起点这一时间轴，次轴的步按自己的理想时刻走，不再紧跟主轴
+typedef struct {
+  uint16_t steps, step_count;
+  uint32_t period, remainder, error;
+  uint32_t next_us;   //下一步相对段起点的时刻
+  unsigned long last_us;  //上一步的时刻（micros），跨段保留
+  int dir;
+  int8_t delta;       //走一步步数加1还是减1
+} axis_dda_t;
+
+static void dda_init(axis_dda_t &dda, uint16_t steps, uint32_t duration, int dir){
+  dda.steps = steps;
+  dda.step_count = 0;
+  dda.dir = dir;
+  if(!steps) return;
+  dda.period = duration / steps;
+  dda.remainder = duration % steps;
+  dda.error = 0;
+  dda.next_us = dda.period / 2;
+}
+
+//主循环卡住过（解析、规划、串口）时，过期的步不能一下全补上：两步之间至少 MIN_STEP_INTERVAL，不然电机丢步
+//补步按电机最快速度走，追上理想时刻后恢复原来的步距
+static bool dda_due(axis_dda_t &dda, uint32_t elapsed, unsigned long now){
+  if(dda.step_count == dda.steps || elapsed < dda.next_us || now - dda.last_us < MIN_STEP_INTERVAL) return false;
+  dda.last_us = now;
+  dda.step_count++;
+  dda.next_us += dda.period;
+  dda.error += dda.remainder;
+  if(dda.error >= dda.steps){ dda.error -= dda.steps; dda.next_us++; }
+  return true;
+}
+
+//步进执行器 每次调用最多给每个电机走一步，由主循环不断轮询
+void stepper_run(){
+  static axis_dda_t dda_m1, dda_m2;  //静态变量，开机全是0
+  static uint32_t segment_us = 0;          //当前段总时长
+  static unsigned long segment_start_us = 0;
+
+  unsigned long now = micros();
+  uint32_t elapsed = now - segment_start_us;
+
+  if(dda_m1.step_count == dda_m1.steps && dda_m2.step_count == dda_m2.steps && elapsed >= segment_us){
+    if(segment_buffer_tail == segment_buffer_head) return;  //队列空
+    const segment_t &seg = segment_buffer[segment_buffer_tail];
+    //紧接上一段的结束时刻开始，步距保持均匀；队列空过则从现在开始
+    if(elapsed - segment_us < seg.interval) segment_start_us += segment_us;
+    else segment_start_us = now;
+    segment_us = (uint32_t)max(seg.steps_m1, seg.steps_m2) * seg.interval;
+    if(segment_us == 0){  //原地等待，从现在开始计时，不能因为接在前一段后面而缩短
+      segment_us = seg.interval;
+      segment_start_us = now;
+    }
+    if(seg.pen != PEN_NO_CHANGE) pen_servo.write(seg.pen == PEN_DOWN ? PEN_DOWN_ANGLE : PEN_UP_ANGLE);
+    dda_init(dda_m1, seg.steps_m1, segment_us, bitRead(seg.direction_bits, M1_DIRECTION_BIT) ? INVERT_M1_DIR : (-1*INVERT_M1_DIR));
+    dda_init(dda_m2, seg.steps_m2, segment_us, bitRead(seg.direction_bits, M2_DIRECTION_BIT) ? INVERT_M2_DIR : (-1*INVERT_M2_DIR));
+    dda_m1.delta = bitRead(seg.direction_bits, M1_DIRECTION_BIT) ? -1 : 1;
+    dda_m2.delta = bitRead(seg.direction_bits, M2_DIRECTION_BIT) ? -1 : 1;
+    segment_buffer_tail = SEGMENT_NEXT(segment_buffer_tail);
+    elapsed = now - segment_start_us;
+  }
+
+  if(dda_due(dda_m1, elapsed, now)){ m1.takeStep(dda_m1.dir); executed_steps_m1 += dda_m1.delta; }
+  if(dda_due(dda_m2, elapsed, now)){ m2.takeStep(dda_m2.dir); executed_steps_m2 += dda_m2.delta; }
+}
+
+//正解：由执行器已经走完的步数算笔现在的位置
+//两根绳长是以两个固定点为圆心的两个圆的半径，笔在两圆交点中下面那个
+void stepper_position(float &x, float &y){
+  float r1 = executed_steps_m1 * DEFAULT_XY_MM_PER_STEP;
+  float r2 = executed_steps_m2 * DEFAULT_XY_MM_PER_STEP;
+  float dx = (r1*r1 - r2*r2 + (float)X_SEPARATION*X_SEPARATION) / (2.0 * X_SEPARATION);
+  x = X_MIN_POS + dx;
+  y = Y_MIN_POS - sqrt(max(r1*r1 - dx*dx, 0.0));
+}
+
+//原地等待 seconds 秒，一段最长65毫秒，长的分几段
+static void dwell(float seconds){
+  seconds += pending_seconds;
+  pending_seconds = 0;
+  while(seconds > 0.000001){
+    segment_t seg;
+    seg.steps_m1 = seg.steps_m2 = 0;
+    seg.direction_bits = 0;
+    seg.interval = min(seconds * 1000000.0, 65535.0);
+    if(seg.interval == 0) break;
+    segment_buffer_push(seg);
+    seconds -= seg.interval * 0.000001;
+  }
+}
+
+//由当前步数移动到目标步数，用时 seconds 秒，放入步进段队列
+//不到一步的小段不产生步，它的时间加到下一段上，总时间不丢
+static void moveto_steps(long target_steps_m1,long target_steps_m2,float seconds) {
+  long dif_steps_m1 = target_steps_m1 - current_steps_M1;
+  long dif_steps_m2 = target_steps_m2 - current_steps_M2;
+
+  seconds += pending_seconds;
+  pending_seconds = 0;
+  if(dif_steps_m1 == 0 && dif_steps_m2 == 0){
+    pending_seconds = seconds;
+  } else {
+    segment_t seg;
+    seg.steps_m1 = abs(dif_steps_m1);
+    seg.steps_m2 = abs(dif_steps_m2);
+    seg.direction_bits = 0;
+    if(dif_steps_m1 < 0) bitSet(seg.direction_bits, M1_DIRECTION_BIT);
+    if(dif_steps_m2 < 0) bitSet(seg.direction_bits, M2_DIRECTION_BIT);
+    uint16_t steps = max(seg.steps_m1, seg.steps_m2);
+    float interval = seconds * 1000000.0 / steps;
+    if(interval <= 65535){
+      seg.interval = max(interval, MIN_STEP_INTERVAL);
+      segment_buffer_push(seg);
+    } else {
+      //一步超过65毫秒（S形从静止起步、减速到停的头尾几段）：段里的步距放不下
+      //拆成一步一段，每步前后各等一半多出的时间，步还在原来的时刻，总时间不丢
+      float wait = (seconds / steps - 0.065535) * 0.5;
+      uint16_t steps_m1 = seg.steps_m1, steps_m2 = seg.steps_m2;
+      for(uint16_t i = 0; i < steps; i++){
+        seg.steps_m1 = (uint32_t)(i + 1) * steps_m1 / steps - (uint32_t)i * steps_m1 / steps;
+        seg.steps_m2 = (uint32_t)(i + 1) * steps_m2 / steps - (uint32_t)i * steps_m2 / steps;
+        seg.interval = 65535;
+        dwell(wait);
+        segment_buffer_push(seg);
+        dwell(wait);
+      }
+    }
+  }
+  current_steps_M1 = target_steps_m1;
+  current_steps_M2 = target_steps_m2;
+}
+
+//舵机抬笔落笔，命令随下一段放入段队列，走到那里时执行
+//抬笔要等舵机转到位才能空走，不然笔会在纸上拖出线；落笔等笔尖落稳再画
+static void pen_command(uint8_t pen){
+  pending_pen = pen;
+  prep.pen = pen;
+  prep.pen_seconds = 0;
+}
+
+//当前空走块从当前速度走完剩余 mm_left 并停下还要多久（落笔前必须停下，退出速度为0）
+//梯形和S形用时相同
+static float block_seconds_left(block_t *block, float mm_left){
+#ifdef S_CURVE_ACCELERATION
+  if(prep.ramp_time > 0 && prep.ramp_dv < 0) return prep.ramp_time - prep.ramp_t;  //已在减速
+#endif
+  float accel = block->acceleration;
+  float peak_speed_sqr = min(block->nominal_speed_sqr, 0.5 * (2 * accel * mm_left + sq(prep.speed)));
+  if(peak_speed_sqr <= sq(prep.speed)){  //已在减速
+    return prep.speed > 0 ? 2 * mm_left / prep.speed : 0;
+  }
+  float peak_speed = SQRT(peak_speed_sqr);
+  float cruise_mm = mm_left - (2 * peak_speed_sqr - sq(prep.speed)) / (2 * accel);
+  return (2 * peak_speed - prep.speed) / accel + max(cruise_mm, 0) / peak_speed;
 }
 
 //直接由当前位置移动到目标位置
-void moveto(float target_X,float target_Y) {
+static void moveto(float target_X,float target_Y,float seconds) {
   long target_steps_m1,target_steps_m2;
   IK(target_X, target_Y, target_steps_m1, target_steps_m2);
-  long dif_abs_steps_run_m1 = abs(target_steps_m1 - current_steps_M1);
-  long dif_abs_steps_run_m2 = abs(target_steps_m2 - current_steps_M2);
-  int dir1 = (target_steps_m1 - current_steps_M1) > 0 ? (-1*INVERT_M1_DIR) : INVERT_M1_DIR;
-  int dir2 = (target_steps_m2 - current_steps_M2) > 0 ? (-1*INVERT_M2_DIR) : INVERT_M2_DIR;
-  long over=0;
-  long i;
-  if(dif_abs_steps_run_m1 > dif_abs_steps_run_m2){
-    for( i=0; i < dif_abs_steps_run_m1; ++i){
-      m1.moveRelativeInSteps(dir1);
-      over+=dif_abs_steps_run_m2;
-      if(over>=dif_abs_steps_run_m1){
-        over-=dif_abs_steps_run_m1;
-        m2.moveRelativeInSteps(dir2);
+  moveto_steps(target_steps_m1, target_steps_m2, seconds);
+}
+
+//下一小段的长度：按时间切，每秒 SEGMENTS_PER_SECOND 段，至少一步
+//慢速的细节切得细，快速的长线切得粗，每秒运动的计算量固定，与图形无关
+static float segment_mm(){
+  return max((float)DEFAULT_XY_MM_PER_STEP, prep.speed * (1.0 / SEGMENTS_PER_SECOND));
+}
+
+#ifdef S_CURVE_ACCELERATION
+//S形加减速的速度曲线 v = v0 + dv * (10u^3 - 15u^4 + 6u^5)，u = t / T
+//两端加速度为0，块与块相接处加速度连续；走过的距离和用时与同样平均加速度的梯形相同，规划器照常按梯形算
+//中点加速度是平均值的15/8倍，规划器因此按 DEFAULT_ACCELERATION 的8/15规划
+static float ramp_speed(float t){
+  float u = t / prep.ramp_time;
+  return prep.ramp_v0 + prep.ramp_dv * u * u * u * (10 + u * (6 * u - 15));
+}
+
+static float ramp_distance(float t){
+  float u = t / prep.ramp_time;
+  return prep.ramp_v0 * t + prep.ramp_dv * prep.ramp_time * u * u * u * u * (2.5 + u * (u - 3));
+}
+
+//S形加减速下切下一小段，返回这段的用时 秒
+//加减速一旦开始就按时间走完，退出速度只会因新块到来而变大，走完再看是否要继续加速
+static float s_curve_next_segment(block_t *block, float &ds){
+  float mm_left = block->millimeters - prep.mm_complete;
+  float accel = block->acceleration;
+  float seg_mm = segment_mm();
+
+  if(prep.ramp_time == 0){
+    float exit_speed_sqr = plan_get_exit_speed_sqr();
+    float target_speed = prep.speed;
+    if(sq(prep.speed) - exit_speed_sqr >= 2 * accel * (mm_left - seg_mm)){
+      //该减速了，时长按剩余距离算，正好在块尾降到退出速度
+      target_speed = min(prep.speed, SQRT(exit_speed_sqr));
+      if(target_speed < prep.speed) prep.ramp_time = 2 * mm_left / (prep.speed + target_speed);
+    } else if(sq(prep.speed) < block->nominal_speed_sqr){
+      //加速到匀速段速度，块太短则加速到还来得及减速的最高速度
+      target_speed = SQRT(min(block->nominal_speed_sqr, 0.5 * (2 * accel * mm_left + sq(prep.speed) + exit_speed_sqr)));
+      prep.ramp_time = (target_speed - prep.speed) / accel;
+    }
+    if(target_speed != prep.speed){
+      prep.ramp_v0 = prep.speed;
+      prep.ramp_dv = target_speed - prep.speed;
+      prep.ramp_t = 0;
+      prep.ramp_mm = prep.mm_complete;
+    } else {
+      prep.ramp_time = 0;
+    }
+  }
+
+  if(prep.ramp_time == 0){  //匀速
+    ds = min(seg_mm, mm_left);
+    if(block->pen == PEN_UP)  //空走不用切小段，一直走到该减速的地方
+      ds = constrain(mm_left - (sq(prep.speed) - plan_get_exit_speed_sqr()) / (2 * accel), ds, mm_left);
+    return ds / max(prep.speed, SQRT(accel * ds));
+  }
+
+  //找走完 seg_mm 的时刻：牛顿法，跳出区间时改用二分，只影响小段长短，不影响速度曲线
+  float s = min(prep.mm_complete + seg_mm, block->millimeters) - prep.ramp_mm;
+  float t = prep.ramp_time;
+  if(ramp_distance(t) > s){
+    float t_lo = prep.ramp_t, t_hi = prep.ramp_time;
+    t = t_lo + seg_mm / max(prep.speed, SQRT(accel * seg_mm));
+    for(byte i = 0; i < 4; i++){
+      if(t <= t_lo || t >= t_hi) t = 0.5 * (t_lo + t_hi);
+      float error = ramp_distance(t) - s;
+      if(error > 0) t_hi = t;
+      else t_lo = t;
+      t -= error / max(ramp_speed(t), 0.1);
+    }
+    t = constrain(t, t_lo, t_hi);
+  }
+
+  float seconds = t - prep.ramp_t;
+  ds = prep.ramp_mm + ramp_distance(t) - prep.mm_complete;
+  if(mm_left - ds < DEFAULT_XY_MM_PER_STEP * 0.5) ds = mm_left;  //到块尾了，剩下的舍入误差不再单独成段
+  prep.ramp_t = t;
+  if(t >= prep.ramp_time){
+    prep.speed = prep.ramp_v0 + prep.ramp_dv;
+    prep.ramp_time = 0;
+  } else {
+    prep.speed = ramp_speed(t);
+  }
+  return seconds;
+}
+#endif
+
+//段生成器：把规划器当前块按速度曲线切成小段放入步进段队列，每秒 SEGMENTS_PER_SECOND 段
+//长线会走圆弧轨迹，切成小段保持直线形态
+void stepper_prep_buffer(){
+  while(SEGMENT_NEXT(segment_buffer_head) != segment_buffer_tail){
+    stepper_run();  //切割一段要几百微秒，中间不能耽误走步
+    if(prep.block == NULL){
+      prep.block = plan_get_current_block();
+      if(prep.block == NULL) return;
+      if(prep.block->pen != prep.pen){
+        //抬笔，或空走没来得及提前落笔：停在这里等舵机
+        pen_command(prep.block->pen);
+        dwell((prep.block->pen == PEN_DOWN ? PEN_DOWN_TIME : PEN_SWING_TIME) * 0.001);
+        prep.pen_seconds = PEN_DOWN_TIME * 0.001;
+      } else if(prep.pen == PEN_DOWN && prep.pen_seconds < PEN_DOWN_TIME * 0.001){
+        //空走中提前落笔了，但笔架到得比落笔快，等笔落稳
+        dwell(PEN_DOWN_TIME * 0.001 - prep.pen_seconds);
+        prep.pen_seconds = PEN_DOWN_TIME * 0.001;
       }
-      delayMicroseconds(LINE_DELAY);
-     }
-  } 
-  else {
-    for(i=0;i<dif_abs_steps_run_m2;++i) {
-      m2.moveRelativeInSteps(dir2);
-      over+=dif_abs_steps_run_m1;
-      if(over>=dif_abs_steps_run_m2) {
-        over-=dif_abs_steps_run_m2;
-        m1.moveRelativeInSteps(dir1);
+      if(prep.block->millimeters == 0) continue;  //原地抬落笔或暂停，没有移动
+      prep.unit_vec[X_AXIS] = (prep.block->target[X_AXIS] - prep.start[X_AXIS]) / prep.block->millimeters;
+      prep.unit_vec[Y_AXIS] = (prep.block->target[Y_AXIS] - prep.start[Y_AXIS]) / prep.block->millimeters;
+      prep.start_steps[X_AXIS] = current_steps_M1;
+      prep.start_steps[Y_AXIS] = current_steps_M2;
+      prep.mm_complete = 0;
+      prep.speed = min(prep.speed, SQRT(prep.block->entry_speed_sqr));
+#ifdef S_CURVE_ACCELERATION
+      prep.ramp_time = 0;
+#endif
+    }
+    block_t *block = prep.block;
+
+    if(block->millimeters == 0){
+      //G4 暂停一次放一段（最长65毫秒），长暂停不会卡住主循环
+      float seconds = min(block->dwell, 0.065);
+      if(seconds > 0){
+        dwell(seconds);
+        block->dwell -= seconds;
+      }
+      if(block->dwell <= 0){
+        prep.block = NULL;
+        plan_discard_current_block();
       }
-      delayMicroseconds(LINE_DELAY);
+      continue;
+    }
+
+    //空走后要落笔：笔架到达前 PEN_DOWN_TIME 开始落笔，到达时正好落稳，不用停下等舵机
+    if(block->pen == PEN_UP && prep.pen == PEN_UP){
+      block_t *next = plan_get_next_block();
+      if(next != NULL && next->pen == PEN_DOWN && block_seconds_left(block, block->millimeters - prep.mm_complete) <= PEN_DOWN_TIME * 0.001)
+        pen_command(PEN_DOWN);
+    }
+
+#ifdef S_CURVE_ACCELERATION
+    float ds;
+    float seconds = s_curve_next_segment(block, ds);
+#else
+    //速度受三个限制：匀速段速度，从当前速度加速，以及在剩余距离内减速到退出速度
+    //退出速度每次都重新读取，新的G代码到来后可以不用减速
+    float ds = min(segment_mm(), block->millimeters - prep.mm_complete);
+    if(block->pen == PEN_UP && prep.speed >= SQRT(block->nominal_speed_sqr))  //空走匀速段不用切小段，一直走到该减速的地方
+      ds = max(ds, block->millimeters - prep.mm_complete - (block->nominal_speed_sqr - plan_get_exit_speed_sqr()) / (2 * block->acceleration));
+    float speed_sqr = min(block->nominal_speed_sqr, sq(prep.speed) + 2 * block->acceleration * ds);
+    speed_sqr = min(speed_sqr, plan_get_exit_speed_sqr() + 2 * block->acceleration * (block->millimeters - prep.mm_complete - ds));
+    float speed = SQRT(speed_sqr);
+    float speed_sum = max(prep.speed + speed, SQRT(block->acceleration * ds));  //从静止到静止的极短块按三角形算
+    float seconds = 2 * ds / speed_sum;
+    prep.speed = speed;
+#endif
+
+    if(prep.pen_seconds < PEN_DOWN_TIME * 0.001) prep.pen_seconds += seconds;
+
+    bool block_end = ds >= block->millimeters - prep.mm_complete;
+    prep.mm_complete += ds;
+    if(block_end){
+      moveto_steps(block->target_steps[X_AXIS], block->target_steps[Y_AXIS], seconds);
+      prep.start[X_AXIS] = block->target[X_AXIS];
+      prep.start[Y_AXIS] = block->target[Y_AXIS];
+      prep.block = NULL;
+      plan_discard_current_block();
+    } else if(block->pen == PEN_UP){
+      float fraction = prep.mm_complete / block->millimeters;
+      moveto_steps(prep.start_steps[X_AXIS] + lround((block->target_steps[X_AXIS] - prep.start_steps[X_AXIS]) * fraction),
+                   prep.start_steps[Y_AXIS] + lround((block->target_steps[Y_AXIS] - prep.start_steps[Y_AXIS]) * fraction), seconds);
+    } else {
+      moveto(prep.start[X_AXIS] + prep.unit_vec[X_AXIS] * prep.mm_complete,
+             prep.start[Y_AXIS] + prep.unit_vec[Y_AXIS] * prep.mm_complete, seconds);
     }
   }
-  current_steps_M1 = target_steps_m1;
-  current_steps_M2 = target_steps_m2;
-  
-  current_position[X_AXIS] = target_X;
-  current_position[Y_AXIS] = target_Y;	
 }
 
-void buffer_line_to_destination(){
-  float cartesian_mm=sqrt( (current_position[X_AXIS] - destination[X_AXIS])* (current_position[X_AXIS] - destination[X_AXIS]) \
-	          + (current_position[Y_AXIS] - destination[Y_AXIS])* (current_position[Y_AXIS] - destination[Y_AXIS]));
-	
-  if(cartesian_mm<=DEFAULT_XY_MM_PER_STEP) { moveto(destination[X_AXIS],destination[Y_AXIS]); return; }
-	
-  long  steps=floor(cartesian_mm/DEFAULT_XY_MM_PER_STEP);
-  float init_X = current_position[X_AXIS];
-  float init_Y = current_position[Y_AXIS];
-  float scale;
-  for(long s=0;s<=steps;++s) {
-    scale=(float)s/(float)steps;
-    moveto((destination[X_AXIS]-init_X)*scale + init_X,
-         (destination[Y_AXIS]-init_Y)*scale + init_Y);
-  }
-  moveto(destination[X_AXIS],destination[Y_AXIS]);
+//等待时一直调用，生成步进段并走步
+void stepper_idle(){
+  stepper_prep_buffer();
+  stepper_run();
+}
+
+//只放入规划器就返回，不等运动完成，G代码可以提前接收
+void buffer_line_to_destination( float fr_mm_s ){
+  plan_buffer_line(destination[X_AXIS], destination[Y_AXIS], fr_mm_s, destination[Z_AXIS] > 0 ? PEN_UP : PEN_DOWN);
+  current_position[X_AXIS] = destination[X_AXIS];
+  current_position[Y_AXIS] = destination[Y_AXIS];
 }
 
+//圆弧按弦高误差切成短直线，全部放入规划器，转角前瞻让速度在整段圆弧上连续
 void buffer_arc_to_destination( float (&offset)[2], bool clockwise ){
 	float r_P = -offset[0], r_Q = -offset[1];
-	byte p_axis = X_AXIS, q_axis = Y_AXIS, l_axis = Z_AXIS;
+	byte p_axis = X_AXIS, q_axis = Y_AXIS;
     const float radius = HYPOT(r_P, r_Q),
                 center_P = current_position[p_axis] - r_P,
                 center_Q = current_position[q_axis] - r_Q,
                 rt_X = destination[p_axis] - center_P,
                 rt_Y = destination[q_axis] - center_Q;
 	float angular_travel = ATAN2(r_P * rt_Y - r_Q * rt_X, r_P * rt_X + r_Q * rt_Y);
-	Serial.println(angular_travel);
 
     if (angular_travel < 0) angular_travel += RADIANS(360);
     if (clockwise) angular_travel -= RADIANS(360);
 	
-	Serial.println(angular_travel);
-	
 	if (angular_travel == 0 && current_position[p_axis] == destination[p_axis] && current_position[q_axis] == destination[q_axis])
       angular_travel = RADIANS(360);
 
-    const float mm_of_travel = HYPOT(angular_travel * radius, 0);  //第一个参数是弧长计算
+    const float mm_of_travel = fabs(angular_travel * radius);  //弧长
     if (mm_of_travel < 0.001) return;
-    Serial.println(mm_of_travel);
 	
-	uint16_t segments = floor(mm_of_travel / (MM_PER_ARC_SEGMENT));
-    if(segments < 1) segments = 1;
+	//弦高不超过 ARC_TOLERANCE 的最长弦 2*sqrt(tol*(2r-tol))
+	//先用 float 算，最后再转成 uint16_t：超大的圆弧直接转会溢出
+	float n = 1;
+	if (radius > ARC_TOLERANCE)
+		n = floor(mm_of_travel / (2 * SQRT(ARC_TOLERANCE * (2 * radius - ARC_TOLERANCE))));
+	//每秒最多 ARC_SEGMENTS_PER_SECOND 条弦，规划器来得及算；小圆弧画得快时弦高会超过 ARC_TOLERANCE
+	n = min(n, floor(mm_of_travel * ARC_SEGMENTS_PER_SECOND / min(feedrate_mm_s, (float)MAX_FEEDRATE)));
+	const uint16_t segments = constrain(n, 1, 65535);
 	
+	const uint8_t pen = destination[Z_AXIS] > 0 ? PEN_UP : PEN_DOWN;
 	float raw[XY];
 	const float theta_per_segment = angular_travel / segments,
-                sin_T = theta_per_segment,
-                cos_T = 1 - 0.5 * sq(theta_per_segment); //小角度近似
+                sq_theta_per_segment = sq(theta_per_segment),
+                sin_T = theta_per_segment - sq_theta_per_segment * theta_per_segment / 6,
+                cos_T = 1 - 0.5 * sq_theta_per_segment; //小角度近似
 				
 	int8_t arc_recalc_count = N_ARC_CORRECTION;
 	
@@ -134,17 +491,11 @@ void buffer_arc_to_destination( float (&offset)[2], bool clockwise ){
 	  raw[p_axis] = center_P + r_P;
       raw[q_axis] = center_Q + r_Q;
 	  
-	 // moveto(raw[p_axis], raw[q_axis]); //逆解执行函数
-	  
-	  #if 1
-		  Serial.print("G0 X");
-		  Serial.print(raw[p_axis]);
-		  Serial.print("Y");
-		  Serial.println(raw[q_axis]);
-      #endif
-	  
-	  
-	  
+	  plan_buffer_line(raw[p_axis], raw[q_axis], feedrate_mm_s, pen);
 	}
 	
+	//最后一段直接到终点，不留累计误差
+	plan_buffer_line(destination[p_axis], destination[q_axis], feedrate_mm_s, pen);
+	current_position[p_axis] = destination[p_axis];
+	current_position[q_axis] = destination[q_axis];
 }
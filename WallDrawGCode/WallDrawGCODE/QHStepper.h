@@ -1,11 +1,29 @@
-
 #ifndef QH_STEPPER_H
 #define QH_STEPPER_H
 
 #include "QH_Configuration.h"
 
+#define M1_DIRECTION_BIT  0   //方向位 置1表示该电机步数减少
+#define M2_DIRECTION_BIT  1
+
+#define PEN_NO_CHANGE     0xFF
+
+//步进段：主循环（生产者）算好的一小段电机动作，由执行器（消费者）按时间间隔走完
+typedef struct {
+  uint16_t steps_m1, steps_m2;   //两电机步数（绝对值）
+  uint8_t  direction_bits;       //方向位
+  uint16_t interval;             //主轴每步间隔（微秒），两电机都不走时是原地等待的时长
+  uint8_t  pen;                  //这段开始时舵机转到的笔状态，PEN_NO_CHANGE 不动
+} segment_t;
+
+void IK(float x,float y,long &target_steps_m1, long &target_steps_m2);
 void stepper_init();
-void buffer_line_to_destination();
+void stepper_run();
+void stepper_prep_buffer();
+void stepper_idle();
+void stepper_position(float &x, float &y);  //执行器已经走到的位置（不是最后放进队列的目标）
+uint8_t segment_buffer_count();
+void buffer_line_to_destination( float fr_mm_s );
 void buffer_arc_to_destination( float (&offset)[2], bool clockwise );
 
 #endif
@@ -16,8 +16,9 @@
 #define SPOOL_CIRC      (SPOOL_DIAMETER * 3.1416)  //线轴周长 35*3.14=109.956
 #define DEFAULT_XY_MM_PER_STEP    (SPOOL_CIRC / STEPS_PER_TURN)  //步进电机步距，最小分辨率 每步线绳被拉动的距离  0.053689mm
 
-#define MM_PER_ARC_SEGMENT  1  //圆弧分割最小每步距离 
+#define ARC_TOLERANCE    0.02  //圆弧切成短直线时允许的弦高误差 mm，越小切得越细
 #define N_ARC_CORRECTION   25  //修正之间的极化段数
+#define ARC_SEGMENTS_PER_SECOND  50  //圆弧每秒最多切成的直线数，每条都要进规划器
 
 
 #define X_SEPARATION  505           //两绳上方的水平距离mm 
@@ -28,7 +29,33 @@
 #define Y_MAX_POS         (-300)   //y轴最大值 画板最下方
 #define Y_MIN_POS         (300)    //y轴最小值 画板最上方  左右两线的固定点到笔的垂直距离，尽量测量摆放准确，误差过大会有畸变
 
-#define LINE_DELAY      1   //步进电机每步的等候时间 （微妙）
+#define MIN_STEP_INTERVAL   1800   //步进电机最快每步间隔（微秒），28BYJ-48 约550步/秒，再快容易丢步
+#define MAX_FEEDRATE        (DEFAULT_XY_MM_PER_STEP * 1000000.0 / MIN_STEP_INTERVAL)  //电机能达到的最快速度 约29.8mm/s，更快的F按这个走
+
+#define DEFAULT_FEEDRATE      20     //画线速度 mm/s，G代码没有F时用这个，F的单位是 mm/min
+#define RAPID_FEEDRATE        30     //G0空走速度 mm/s
+#define DEFAULT_ACCELERATION  50     //最大加速度 mm/s^2，笔架是吊着的，太大会晃
+#define JUNCTION_DEVIATION    0.05   //转角偏差 mm，转角处允许偏离路径的距离，越大转角越快
+#define BLEND_TOLERANCE       0.1    //G64 不带P时路径允许的偏差 mm
+#define BLEND_MAX_POINTS      8      //G64 连续路径模式一块最多合并掉的点数
+//#define S_CURVE_ACCELERATION       //S形加减速：加速度从0平滑升到最大再降回0，吊笔晃动小，但短线多的图会慢一些；注释掉为梯形加减速
+
+#define PEN_DOWN 1  //笔状态  下笔  G代码 Z<=0
+#define PEN_UP   0  //笔状态  抬笔  G代码 Z>0
+#define PEN_UP_Z 1  //M5 抬笔时设的Z
+
+#define PEN_SERVO_PIN        A0   //抬笔舵机
+#define PEN_UP_ANGLE         60   //抬笔角度
+#define PEN_DOWN_ANGLE       95   //落笔角度
+#define SERVO_MS_PER_DEGREE  2    //舵机每转1度的时间（毫秒），SG90 约0.1秒转60度
+#define PEN_SETTLE_TIME      30   //落笔后笔尖在纸上稳定的时间（毫秒）
+#define PEN_SWING_TIME  (abs(PEN_DOWN_ANGLE - PEN_UP_ANGLE) * SERVO_MS_PER_DEGREE)  //舵机转过抬落笔角度的时间，抬笔后等这么久再空走
+#define PEN_DOWN_TIME   (PEN_SWING_TIME + PEN_SETTLE_TIME)  //落笔用时，空走到终点前这么久开始落笔，笔架到达时正好落稳
+
+#define SEGMENTS_PER_SECOND  100  //段生成器每秒运动切成的小段数，速度越快每段越长，最短一步
+
+#define BLOCK_BUFFER_SIZE    8    //规划器前瞻的直线数，必须是2的幂
+#define SEGMENT_BUFFER_SIZE  16   //步进段队列长度，必须是2的幂，队列满时主循环等待执行器取走一段
 
 //两个电机的旋转方向  1正转  -1反转  
 //调节进出方向可垂直反转图像
@@ -42,9 +69,9 @@
 #define HYPOT2(x,y) (sq(x)+sq(y))
 #define HYPOT(x,y)  SQRT(HYPOT2(x,y))
 
-extern String gcode_command;
 extern float destination[XYZ];
 extern float current_position[XYZ];
+extern float feedrate_mm_s;  //G1的速度，G代码中的F修改
 extern long current_steps_M1, current_steps_M2; //当前步进电机相对于0点位置总步数
 
 #endif
@@ -1,17 +1,19 @@
 #include "QH_Configuration.h"
 #include "gcode_parser.h"
 #include "QHStepper.h"
+#include "QHPlanner.h"
 
 #include <Servo.h>
 
-String gcode_command="";
 float destination[XYZ] = {0,0,0};
 float current_position[XYZ] = {0,0,0};
+float feedrate_mm_s = DEFAULT_FEEDRATE;
 long current_steps_M1 = 0, current_steps_M2 = 0;
 
 void setup() {
   Serial.begin(115200);
   stepper_init();
+  gcode.polyline(gcode_G7);
   delay(1200);
   Serial.println("Grbl 1.1h ['$' for help]");
   delay(1200);
@@ -19,22 +21,33 @@ void setup() {
 }
 
 void loop() {
-  if( get_command() > 0 ){
-    process_parsed_command();
-    gcode_command = "";
-    Serial.println("ok");
+  stepper_idle();
+  if(plan_get_current_block() == NULL) plan_flush();  //规划器空了，G64 留着等合并的点不能再等
+  //规划器满时先不读串口，数据留在串口缓冲区里，主循环继续走步
+  if( !plan_check_full_buffer() && get_command() > 0 ){
+    uint8_t status = process_parsed_command();
+    if(status == STATUS_OK) Serial.println("ok");
+    else { Serial.print("error:"); Serial.println(status); }
   } 
 }
 
+//串口来的字节直接送进分词器，读完一行返回1，'?' 随时回状态
 byte get_command(){
-  static int len = 0;
-  static char tmpC = 0;
-  while(Serial.available() > 0){
-    tmpC = Serial.read();
-    if(tmpC == 0x3f) continue;
-    if(tmpC == 10 || len > 35 ){  len = 0; return 1;}
-    gcode_command += tmpC;
-    len++;
-  }
-  return 0;
+  return gcode.read(Serial, report_status) ? 1 : 0;
+}
+
+//实时状态查询 '?' Bf: 步进段队列空位, 串口缓冲区空位
+//MPos 是笔现在的位置，由执行器走完的步数算；current_position 是最后放进规划器的目标，要等队列走完才到
+void report_status(){
+  float x, y;
+  stepper_position(x, y);
+  Serial.print(segment_buffer_count() > 0 || plan_get_current_block() != NULL ? "<Run|MPos:" : "<Idle|MPos:");
+  Serial.print(x, 3);
+  Serial.print(",");
+  Serial.print(y, 3);
+  Serial.print(",0.000|Bf:");
+  Serial.print(SEGMENT_BUFFER_SIZE - 1 - segment_buffer_count());
+  Serial.print(",");
+  Serial.print(SERIAL_RX_BUFFER_SIZE - Serial.available());
+  Serial.println(">");
 }
@@ -1,109 +1,162 @@
 #include "gcode_parser.h"
 
-void process_parsed_command() {
-   gcode_command.toUpperCase();
-   if(gcode_command.indexOf('G') > -1){
-      switch(gcode_command.substring(gcode_command.indexOf('G')+1,gcode_command.indexOf('G')+2) .toInt()){
-        case 0:  
-        case 1:   gcode_G0_G1();  break;
-        case 2:   gcode_G2_G3(true); break;
-        case 3:   gcode_G2_G3(false); break;
-        case 4:   gcode_G4();     break;      
-      }
-   }else if(gcode_command.indexOf('M') > -1){
-      switch(gcode_command.substring(gcode_command.indexOf('M')+1,gcode_command.indexOf('M')+2) .toInt()){
-        case 3:   gcode_M3();   break;
-        case 4:   gcode_M5();   break;
+//分词、定点数、G M 派发表和模态状态都在共用库 GCodeReader 里，SD卡固件用的是同一个
+//这里只管执行：把读好的一行交给规划器
+GCodeReader gcode;  //开机为 G0，和Grbl一样
+
+//坐标：G91 时加到上一个目标点上，G90 时加上 G92 偏移
+static float gcode_axis(char letter, uint8_t axis){
+  return gcode.axis(letter, destination[axis]);
+}
+
+//F 单位 mm/min（G20 时 in/min），G0 也可以带F，之后的G1 G2 G3按这个速度
+static void get_feedrate(){
+	if( gcode.seen('F') && gcode.value('F') > 0 ) feedrate_mm_s = gcode.length('F') / 60;
+}
+
+//执行顺序和Grbl一样：模式，F，M，暂停，G28 G92，运动，最后是程序结束
+//行里有数溢出时整行不执行；返回 STATUS_OK 或 Grbl 的错误号
+uint8_t process_parsed_command() {
+   if(gcode.error()) return STATUS_BAD_NUMBER_FORMAT;
+   //G17 只有XY平面，不用做什么；G20 G21 G90 G91 和运动模式读行时已经记进模态
+   if(gcode.group(GCODE_GROUP_PATH) == 61) gcode_G61();
+   if(gcode.group(GCODE_GROUP_PATH) == 64) gcode_G64();
+   get_feedrate();
+
+   switch(gcode.group(GCODE_GROUP_SPINDLE)){
+     case 3:
+     case 4:   gcode_M3();   break;
+     case 5:   gcode_M5();   break;
+   }
+
+   //G28 G92 用掉这一行的坐标，不再按运动模式走
+   bool axis_used = false;
+   switch(gcode.group(GCODE_GROUP_NON_MODAL)){
+     case 4:   gcode_G4();                     break;
+     case 7:   axis_used = true;               break;  //G7 的点读行时已经排进规划器
+     case 28:  gcode_G28();  axis_used = true; break;
+     case 92:  gcode_G92();  axis_used = true; break;
+   }
+
+   //G0 G1 G2 G3 是模态的，后面只有坐标的行按上一个运动模式走
+   uint8_t status = STATUS_OK;
+   if(!axis_used && gcode.has_axis()){
+      switch(gcode.motion()){
+        case 0:   gcode_G0_G1(true);  break;
+        case 1:   gcode_G0_G1(false); break;
+        case 2:   status = gcode_G2_G3(true); break;
+        case 3:   status = gcode_G2_G3(false); break;
       }
    }
+
+   if(gcode.group(GCODE_GROUP_STOP) >= 0) gcode_M2();
+   return status;
 }
 
 
-void gcode_G0_G1(){
-	if( gcode_command.indexOf('X') > -1){
-		if( gcode_command.indexOf('Y') > -1 ) destination[X_AXIS] = gcode_command.substring(gcode_command.indexOf('X')+1,gcode_command.indexOf('Y')).toFloat();
-		else if( gcode_command.indexOf('Z') > -1 ) destination[X_AXIS] = gcode_command.substring(gcode_command.indexOf('X')+1,gcode_command.indexOf('Z')).toFloat(); 
-		else if( gcode_command.indexOf('S') > -1 ) destination[X_AXIS] = gcode_command.substring(gcode_command.indexOf('X')+1,gcode_command.indexOf('S')).toFloat(); 
-		else destination[X_AXIS] = gcode_command.substring(gcode_command.indexOf('X')+1,gcode_command.length()).toFloat();
-	}
-	if( gcode_command.indexOf('Y') > -1){
-		if( gcode_command.indexOf('Z') > -1 ) destination[Y_AXIS] = gcode_command.substring(gcode_command.indexOf('Y')+1,gcode_command.indexOf('Z')).toFloat(); 
-		else if( gcode_command.indexOf('S') > -1 ) destination[Y_AXIS] = gcode_command.substring(gcode_command.indexOf('Y')+1,gcode_command.indexOf('S')).toFloat(); 
-		else destination[Y_AXIS] = gcode_command.substring(gcode_command.indexOf('Y')+1,gcode_command.length()).toFloat();
-	}
-	
-	if( gcode_command.indexOf('Z') > -1){
-		if( gcode_command.indexOf('S') > -1 ) destination[Z_AXIS] = gcode_command.substring(gcode_command.indexOf('Z')+1,gcode_command.indexOf('S')).toFloat(); 
-		else destination[Z_AXIS] = gcode_command.substring(gcode_command.indexOf('Z')+1,gcode_command.length()).toFloat();
-	}
-//	Serial.print("G01 X"); Serial.print(destination[X_AXIS]);
-//	Serial.print("Y"); Serial.print(destination[Y_AXIS]);
-//	Serial.print("Z"); Serial.println(destination[Z_AXIS]);
-//	
-	buffer_line_to_destination();
-	
+void gcode_G0_G1( bool rapid ){
+	if( gcode.seen('X') ) destination[X_AXIS] = gcode_axis('X', X_AXIS);
+	if( gcode.seen('Y') ) destination[Y_AXIS] = gcode_axis('Y', Y_AXIS);
+	if( gcode.seen('Z') ) destination[Z_AXIS] = gcode_axis('Z', Z_AXIS);
+	buffer_line_to_destination( rapid ? RAPID_FEEDRATE : feedrate_mm_s );
 }
 
-void gcode_G2_G3( bool clockwise ){
-	if( gcode_command.indexOf('X') > -1){
-		if( gcode_command.indexOf('Y') > -1 ) destination[X_AXIS] = gcode_command.substring(gcode_command.indexOf('X')+1,gcode_command.indexOf('Y')).toFloat();
-		else if( gcode_command.indexOf('Z') > -1 ) destination[X_AXIS] = gcode_command.substring(gcode_command.indexOf('X')+1,gcode_command.indexOf('Z')).toFloat(); 
-		else if( gcode_command.indexOf('S') > -1 ) destination[X_AXIS] = gcode_command.substring(gcode_command.indexOf('X')+1,gcode_command.indexOf('S')).toFloat(); 
-		else destination[X_AXIS] = gcode_command.substring(gcode_command.indexOf('X')+1,gcode_command.length()).toFloat();
-	}
-	if( gcode_command.indexOf('Y') > -1){
-		if( gcode_command.indexOf('Z') > -1 ) destination[Y_AXIS] = gcode_command.substring(gcode_command.indexOf('Y')+1,gcode_command.indexOf('Z')).toFloat(); 
-		else if( gcode_command.indexOf('S') > -1 ) destination[Y_AXIS] = gcode_command.substring(gcode_command.indexOf('Y')+1,gcode_command.indexOf('S')).toFloat(); 
-		else destination[Y_AXIS] = gcode_command.substring(gcode_command.indexOf('Y')+1,gcode_command.length()).toFloat();
-	}
+//圆弧参数不对时不走，目标点退回现在的位置，返回错误号；和Grbl一样检查，不会算出 NaN 的圆心
+uint8_t gcode_G2_G3( bool clockwise ){
+	float p1 = current_position[X_AXIS], q1 = current_position[Y_AXIS],
+	      p2 = gcode.seen('X') ? gcode_axis('X', X_AXIS) : destination[X_AXIS],
+	      q2 = gcode.seen('Y') ? gcode_axis('Y', Y_AXIS) : destination[Y_AXIS];
 	
 	float arc_offset[2] = { 0.0, 0.0 };
 	
-	if( gcode_command.indexOf('R') > -1){
-		float r = 0,
-		      p1 = current_position[X_AXIS], q1 = current_position[Y_AXIS],
-              p2 = destination[X_AXIS], q2 = destination[Y_AXIS];
-		if( gcode_command.indexOf('S') > -1 ) r = gcode_command.substring(gcode_command.indexOf('R')+1,gcode_command.indexOf('S')).toFloat(); 
-		else r = gcode_command.substring(gcode_command.indexOf('R')+1,gcode_command.length()).toFloat();
-		
-		if (r && (p2 != p1 || q2 != q1)) {
-          const float e = clockwise ^ (r < 0) ? -1 : 1,           
-                      dx = p2 - p1, dy = q2 - q1,                 
-                      d = sqrt(sq(dx)+sq(dy)),                          
-                      h = sqrt(sq(r) - sq(d * 0.5)),               
-                      mx = (p1 + p2) * 0.5, my = (q1 + q2) * 0.5,  
-                      sx = -dy / d, sy = dx / d,                   
-                      cx = mx + e * h * sx, cy = my + e * h * sy;  
-          arc_offset[0] = cx - p1;
-          arc_offset[1] = cy - q1;
-	    }
+	if( gcode.seen('R') ){
+		float r = gcode.length('R');
+		if (p2 == p1 && q2 == q1) return STATUS_INVALID_TARGET;  //R 画不了整圆
+		const float dx = p2 - p1, dy = q2 - q1,
+		            d = sqrt(sq(dx)+sq(dy)),
+		            h2 = sq(r) - sq(d * 0.5);
+		if (h2 < 0) return STATUS_ARC_RADIUS_ERROR;
+		const float e = clockwise ^ (r < 0) ? -1 : 1,
+		            h = sqrt(h2),
+		            mx = (p1 + p2) * 0.5, my = (q1 + q2) * 0.5,
+		            sx = -dy / d, sy = dx / d,
+		            cx = mx + e * h * sx, cy = my + e * h * sy;
+		arc_offset[0] = cx - p1;
+		arc_offset[1] = cy - q1;
 	} else {
-        if (gcode_command.indexOf('I') > -1) {
-			if( gcode_command.indexOf('J') > -1 ) arc_offset[0] = gcode_command.substring(gcode_command.indexOf('I')+1,gcode_command.indexOf('J')).toFloat(); 
-			else if( gcode_command.indexOf('S') > -1 ) arc_offset[0] = gcode_command.substring(gcode_command.indexOf('I')+1,gcode_command.indexOf('S')).toFloat(); 
-			else arc_offset[0] = gcode_command.substring(gcode_command.indexOf('I')+1,gcode_command.length()).toFloat();
-		}
-        if (gcode_command.indexOf('J') > -1){
-			if( gcode_command.indexOf('S') > -1 ) arc_offset[1] = gcode_command.substring(gcode_command.indexOf('J')+1,gcode_command.indexOf('S')).toFloat(); 
-			else arc_offset[1] = gcode_command.substring(gcode_command.indexOf('J')+1,gcode_command.length()).toFloat();
-		} 
-    }
-	Serial.print("G23 X"); Serial.print( destination[X_AXIS] );
-	Serial.print("Y"); Serial.print( destination[Y_AXIS] );
-	Serial.print("I"); Serial.print( arc_offset[0] );
-	Serial.print("J"); Serial.println( arc_offset[1] );
-	
+		if( !gcode.seen('I') && !gcode.seen('J') ) return STATUS_NO_OFFSETS_IN_PLANE;
+		if( gcode.seen('I') ) arc_offset[0] = gcode.length('I');  //I J 总是相对圆弧起点
+		if( gcode.seen('J') ) arc_offset[1] = gcode.length('J');
+		//终点到圆心的距离和半径差超过 0.5mm，或超过 0.005mm 且超过半径的 0.1% 时，终点不在圆上
+		const float r = HYPOT(arc_offset[0], arc_offset[1]),
+		            r_end = HYPOT(p1 + arc_offset[0] - p2, q1 + arc_offset[1] - q2),
+		            delta = fabs(r_end - r);
+		if (delta > 0.5 || (delta > 0.005 && delta > 0.001 * r)) return STATUS_INVALID_TARGET;
+	}
+	destination[X_AXIS] = p2;
+	destination[Y_AXIS] = q2;
 	buffer_arc_to_destination( arc_offset, clockwise );
+	return STATUS_OK;
 }
 
+//G4 P 暂停 P 秒（和Grbl一样单位是秒），排进运动队列，前面的线走完才开始等
 void gcode_G4(){
-	Serial.println("G4"); 
+	if( gcode.seen('P') ) plan_buffer_dwell(gcode.value('P'));
+}
+
+//G7 折线的一个点：读行时分词器每读到一对 X Y 就调一次，直接排进规划器，一行有多少点都不用存
+//F 写在 G7 行里点的前面时从这个点开始按新速度
+void gcode_G7( float dx, float dy ){
+	get_feedrate();
+	destination[X_AXIS] += dx;
+	destination[Y_AXIS] += dy;
+	buffer_line_to_destination( feedrate_mm_s );
+}
+
+//G28 回到原点（开机时笔的位置）：先抬笔，带坐标时先空走到这个中间点，再空走回原点
+void gcode_G28(){
+	gcode_M5();
+	if( gcode.seen('X') || gcode.seen('Y') ){
+		if( gcode.seen('X') ) destination[X_AXIS] = gcode_axis('X', X_AXIS);
+		if( gcode.seen('Y') ) destination[Y_AXIS] = gcode_axis('Y', Y_AXIS);
+		buffer_line_to_destination( RAPID_FEEDRATE );
+	}
+	destination[X_AXIS] = destination[Y_AXIS] = 0;
+	buffer_line_to_destination( RAPID_FEEDRATE );
 }
 
+//G92 把笔现在的位置设成给出的坐标，不走动；只改 X Y，Z 决定笔的状态，不偏移
+void gcode_G92(){
+	gcode.set_origin('X', current_position[X_AXIS]);
+	gcode.set_origin('Y', current_position[Y_AXIS]);
+}
+
+//G61 精确路径：每个点都走到
+void gcode_G61(){
+	plan_set_blend_tolerance(0);
+}
+
+//G64 P 连续路径：偏离路径不超过 P mm，密集小线段合并，转角更快；不带P用 BLEND_TOLERANCE
+void gcode_G64(){
+	float p = BLEND_TOLERANCE;
+	if( gcode.seen('P') ) p = gcode.value('P');
+	plan_set_blend_tolerance(max(p, 0));
+}
+
+//M3 M4 落笔（主轴/激光开），M5 抬笔：改变Z，和 G1 Z0 / G0 Z5 一样排进运动队列，之后的G0 G1 都按这个笔状态
 void gcode_M3(){
-	Serial.println("M3"); 
+	destination[Z_AXIS] = current_position[Z_AXIS] = 0;
+	buffer_line_to_destination( feedrate_mm_s );
 }
 
 void gcode_M5(){
-	Serial.println("M5"); 
+	destination[Z_AXIS] = current_position[Z_AXIS] = PEN_UP_Z;
+	buffer_line_to_destination( feedrate_mm_s );
+}
+
+//M2 M30 程序结束：抬笔，和Grbl一样回到 G1 G90，G64 留着的点交给规划器
+void gcode_M2(){
+	gcode_M5();
+	plan_flush();
+	gcode.program_end();
 }
@@ -4,12 +4,29 @@
 
 #include "QH_Configuration.h"
 #include "QHStepper.h"
+#include "QHPlanner.h"
+#include <GCodeReader.h>  //共用的G代码前端，在 Lib/libraries/GCodeReader，复制到 我的文档->Arduino->libraries 下
 
-void process_parsed_command();
-void gcode_G0_G1();
-void gcode_G2_G3( bool clockwise );
+extern GCodeReader gcode;
+
+//执行结果，和Grbl的错误号一样，串口回 error:号
+#define STATUS_OK                    0
+#define STATUS_BAD_NUMBER_FORMAT     2   //数值溢出
+#define STATUS_INVALID_TARGET        33  //圆弧终点不在圆上，或 R 圆弧起点终点相同
+#define STATUS_ARC_RADIUS_ERROR      34  //R 比起点终点距离的一半还小
+#define STATUS_NO_OFFSETS_IN_PLANE   35  //圆弧没有 I J 也没有 R
+
+uint8_t process_parsed_command();
+void gcode_G0_G1( bool rapid );
+uint8_t gcode_G2_G3( bool clockwise );
 void gcode_G4();
+void gcode_G7( float dx, float dy );
+void gcode_G28();
+void gcode_G92();
+void gcode_G61();
+void gcode_G64();
 void gcode_M3();
 void gcode_M5();
+void gcode_M2();
 
 #endif
@@ -15,6 +15,8 @@
 	//上面报错，请观看视频教程 2分30秒起 https://www.bilibili.com/video/BV1ff4y1975o/
 #include <Servo.h>
 #include <SD.h>  //需要SD卡读卡器模块，或者tf读卡器模块 如果没有该lib请按Ctrl+Shift+I 从 库管理器中搜索 SD，并安装
+#include <GCodeReader.h>  //G代码前端，在本项目 Lib/libraries/GCodeReader，复制到 我的文档->Arduino->libraries 下
+#include <GCodeBinary.h>  //nc2bin 转出来的二进制文件格式，和 GCodeReader 在同一个库里
 
 
 
@@ -30,8 +32,9 @@
 
 
 
-#define step_delay      1   //步进电机每步的等候时间 （微妙）
-#define TPD             300   //转弯等待时间（毫秒），由于惯性笔会继续运动，暂定等待笔静止再运动。
+#define step_delay      2240   //步进电机每步的间隔时间（微秒），28BYJ-48 约450步/秒
+#define SEGMENTS_PER_SECOND  50   //长线每秒运动切成的小段数，走得快的线每段长，每秒算逆解的次数固定
+#define RAPID_FEED_RATE 0     //G0空走速度（mm/min），0表示按 step_delay 最快速度走
 
 
 //两个电机的旋转方向  1正转  -1反转  
@@ -61,6 +64,8 @@ static long laststep1, laststep2; //当前线长度 记录笔位置
 //抬笔舵机的角度参数  具体数值要看摆臂的安放位置，需要调节
 #define PEN_UP_ANGLE    60  //抬笔
 #define PEN_DOWN_ANGLE  95  //落笔
+#define SERVO_MS_PER_DEGREE  2    //舵机每转1度的时间（毫秒），SG90 约0.1秒转60度
+#define PEN_SETTLE_TIME      30   //落笔后笔尖在纸上稳定的时间（毫秒）
 //需要调节的参数 =============================================
 
 
@@ -82,10 +87,12 @@ struct point actuatorPos;
 static float posx;
 static float posy;
 static float posz;  // pen state
-static float feed_rate = 0;
+static float feed_rate = 0;   //G1画线速度（mm/min），由G代码中的F设定，0表示按 step_delay 最快速度走
+static float move_rate = 0;   //当前这条线的速度，G0用 RAPID_FEED_RATE，G1用 feed_rate
 
 // pen state 笔状态（抬笔，落笔）.
 static int ps;
+static unsigned long pen_ready_ms;  //舵机预计转到位的时刻，到这之前电机不动
 
 /*以下为G代码通讯参数 */
 #define BAUD            (115200)    //串口速率，用于传输G代码或调试 可选9600，57600，115200 或其他常用速率
@@ -157,13 +164,15 @@ void pen_state(int pen_st) {
 
 
 //
+//抬笔落笔不在这里死等：按舵机转动时间记下到位时刻，读SD卡、解析下一行的时间和舵机转动重叠，
+//电机要走时才等到位，抬笔后不会带着笔在纸上拖线
 void pen_down()
 {
   if (ps==PEN_UP_ANGLE)
   {
     ps=PEN_DOWN_ANGLE;
     pen.write(ps);
-    delay(TPD);
+    pen_ready_ms = millis() + abs(PEN_DOWN_ANGLE - PEN_UP_ANGLE) * SERVO_MS_PER_DEGREE + PEN_SETTLE_TIME;
   }
 
 }
@@ -174,11 +183,18 @@ void pen_up()
   {
     ps=PEN_UP_ANGLE;
     pen.write(ps);
+    pen_ready_ms = millis() + abs(PEN_DOWN_ANGLE - PEN_UP_ANGLE) * SERVO_MS_PER_DEGREE;
   }
 
   
 }
 
+//等舵机转到位
+static void pen_wait()
+{
+  while ((long)(millis() - pen_ready_ms) < 0);
+}
+
 //------------------------------------------------------------------------------
 //调试代码串口输出机器状态
 void where() {
@@ -227,7 +243,7 @@ static void arc(float cx, float cy, float x, float y,  float dir) {
   // simplifies to
   float len = abs(theta) * radius;
 
-  int i, segments = floor(len / TPS);
+  int i, segments = floor(len / segment_length());
 
   float nx, ny, nz, angle3, scale;
 
@@ -300,33 +316,40 @@ void moveto(float x,float y) {
   long ad2=abs(d2);
   int dir1=d1>0 ? M1_REEL_IN : M1_REEL_OUT;
   int dir2=d2>0 ? M2_REEL_IN : M2_REEL_OUT;
-  long over=0;
-  long i;
-
-
-  if(ad1>ad2) {
-    for(i=0;i<ad1;++i) {
-      
-      m1.moveRelativeInSteps(dir1);
-      over+=ad2;
-      if(over>=ad1) {
-        over-=ad1;
-        m2.moveRelativeInSteps(dir2);
-      }
-      delayMicroseconds(step_delay);
-     }
-  } 
-  else {
-    for(i=0;i<ad2;++i) {
-      m2.moveRelativeInSteps(dir2);
-      over+=ad1;
-      if(over>=ad2) {
-        over-=ad2;
-        m1.moveRelativeInSteps(dir1);
-      }
-      delayMicroseconds(step_delay);
+  //两个电机各用一个DDA，在同一时间轴上按各自的理想时刻走步：
+  //n 步均匀分布在整段时间 total 内，第 k 步在 (k+0.5)*total/n，次轴不再紧跟主轴的步
+  unsigned long total=max(ad1,ad2)*step_delay;
+  if(move_rate>0) {  //按速度算这一小段的用时，比电机最快速度慢时用它
+    float len=sqrt((x-posx)*(x-posx)+(y-posy)*(y-posy));
+    unsigned long t=len*60000000.0/move_rate;
+    if(t>total) total=t;
+  }
+  unsigned long p1=0,r1=0,e1=0,t1=0;
+  unsigned long p2=0,r2=0,e2=0,t2=0;
+  if(ad1) { p1=total/ad1; r1=total%ad1; t1=p1/2; }
+  if(ad2) { p2=total/ad2; r2=total%ad2; t2=p2/2; }
+  long i1=0,i2=0;
+  if(ad1 || ad2) pen_wait();
+  unsigned long start=micros();
+
+  while(i1<ad1 || i2<ad2) {
+    unsigned long now=micros()-start;
+    if(i1<ad1 && now>=t1) {
+      m1.takeStep(dir1);
+      i1++;
+      t1+=p1;
+      e1+=r1;
+      if(e1>=(unsigned long)ad1) { e1-=ad1; t1++; }
+    }
+    if(i2<ad2 && now>=t2) {
+      m2.takeStep(dir2);
+      i2++;
+      t2+=p2;
+      e2+=r2;
+      if(e2>=(unsigned long)ad2) { e2-=ad2; t2++; }
     }
   }
+  while(micros()-start<total) ;  //等到整段结束，下一段的第一步才不会提前
 
   laststep1=l1;
   laststep2=l2;
@@ -336,6 +359,14 @@ void moveto(float x,float y) {
   
 }
 
+//------------------------------------------------------------------------------
+//切割长线时每小段的长度：按时间切，每秒 SEGMENTS_PER_SECOND 段，至少一步
+static float segment_length() {
+  float mm_s = TPS * 1000000.0 / step_delay;  //电机最快速度
+  if (move_rate > 0 && move_rate / 60 < mm_s) mm_s = move_rate / 60;
+  return max(TPS, mm_s / SEGMENTS_PER_SECOND);
+}
+
 //------------------------------------------------------------------------------
 //长距离移动会走圆弧轨迹，所以将长线切割成短线保持直线形态
 static void line_safe(float x,float y) {
@@ -345,13 +376,14 @@ static void line_safe(float x,float y) {
 
   float len=sqrt(dx*dx+dy*dy);
   
-  if(len<=TPS) {
+  float seg=segment_length();
+  if(len<=seg) {
     moveto(x,y);
     return;
   }
   
   // too long!
-  long pieces=floor(len/TPS);
+  long pieces=floor(len/seg);
   float x0=posx;
   float y0=posy;
   float a;
@@ -370,81 +402,206 @@ static void line_safe(float x,float y) {
 
 void line(float x,float y) 
 {
-  line_safe(x,y);
+  if (ps==PEN_UP_ANGLE)
+    moveto(x,y);  //抬笔空走不用保持直线，两电机在线长上直接走到终点，不切小段
+  else
+    line_safe(x,y);
 }
 
 
 
 //********************************
-void nc(String st)
+//G代码前端用共用库 GCodeReader（和串口固件 WallDrawGCODE 同一个）：逐字节分词，不存整行，模态状态也在里面
+GCodeReader gcode(1);  //开机为 G1，不写G的老文件按F画
+
+//执行读好的一行
+void nc()
 {
+  if (gcode.error()) {  //有数溢出，整行不执行
+    Serial.println("error: number overflow");
+    return;
+  }
 
-String xx,yy,zz;
-int ok=1;
+  if (gcode.seen('F') && gcode.value('F') > 0)  //F 单位 mm/min，对之后的G1都有效
+    feed_rate = gcode.length('F');
+  if (gcode.motion() == 0)  //G0 G00 空走
+    move_rate = RAPID_FEED_RATE;
+  else
+    move_rate = feed_rate;
 
+  switch (gcode.group(GCODE_GROUP_SPINDLE)) {
+    case 3:
+    case 4: pen_down(); break;
+    case 5: pen_up();   break;
+  }
 
-  st.toUpperCase();
-  
-  float x,y,z;
-  int px,py,pz;
-  px = st.indexOf('X');
-  py = st.indexOf('Y');
-  pz = st.indexOf('Z');
-  if (px==-1 || py==-1) ok=0; 
-  if (pz==-1) 
-    {
-      pz=st.length();
-    }
-    else
-    {   
-      zz = st.substring(pz+1,st.length());
-      z  = zz.toFloat();
-      if (z>0)  pen_up();
-      if (z<=0) pen_down();
-    }
+  switch (gcode.group(GCODE_GROUP_NON_MODAL)) {
+    case 4:  //G4 P 暂停 P 秒
+      if (gcode.seen('P')) {
+        pen_wait();
+        delay(gcode.value('P') * 1000);
+      }
+      break;
+    case 28:  //抬笔，有坐标时先空走到中间点，再回原点
+      pen_up();
+      move_rate = RAPID_FEED_RATE;
+      if (gcode.seen('X') || gcode.seen('Y'))
+        line(gcode.seen('X') ? gcode.axis('X', posx) : posx, gcode.seen('Y') ? gcode.axis('Y', posy) : posy);
+      line(0, 0);
+      break;
+    case 92:  //笔现在的位置设成给出的坐标
+      gcode.set_origin('X', posx);
+      gcode.set_origin('Y', posy);
+      break;
+  }
 
-  xx = st.substring(px+1,py);
-  yy = st.substring(py+1,pz);
-  
-  
-  
-  xx.trim();//缩进，去掉末尾空格*/
-  yy.trim();
+  //G28 G92 用掉了这一行的坐标，G7 的点读行时已经画了；G2 G3 和以前一样直接走到终点（arc() 每段都会抬落笔，不能用在这里）
+  if (gcode.group(GCODE_GROUP_NON_MODAL) != 28 && gcode.group(GCODE_GROUP_NON_MODAL) != 92 && gcode.group(GCODE_GROUP_NON_MODAL) != 7) {
+    if (gcode.seen('Z'))
+      {
+        posz = gcode.axis('Z', posz);
+        if (posz > 0)  pen_up();
+        else pen_down();
+      }
 
-  if (ok) line(xx.toFloat(),yy.toFloat());
-  
+    //只写一个坐标的行，另一个坐标不变
+    if (gcode.seen('X') || gcode.seen('Y'))
+      line(gcode.seen('X') ? gcode.axis('X', posx) : posx, gcode.seen('Y') ? gcode.axis('Y', posy) : posy);
+  }
+
+  if (gcode.group(GCODE_GROUP_STOP) >= 0) {  //M2 M30 程序结束
+    pen_up();
+    gcode.program_end();
+  }
+}
+
+//G7 折线的一个点：读行时分词器每读到一对 X Y 就调一次，相对上一个点画线
+void nc_point(float dx, float dy)
+{
+  if (gcode.seen('F') && gcode.value('F') > 0)  //G7 行里写在点前面的 F
+    feed_rate = gcode.length('F');
+  move_rate = feed_rate;
+  line(posx + dx, posy + dy);
+}
+
+//********************************
+//二进制文件（Tools/nc2bin 转的）：操作码加增量，不用解析文本，文件也小很多
+static uint8_t bin_crc;
+static bool bin_check;
+
+static int bin_byte() {
+  int b = myFile.read();
+  if (bin_check && b >= 0) bin_crc = wdb_crc8(bin_crc, b);
+  return b;
+}
+
+static int32_t bin_varint() {
+  uint32_t v = 0;
+  int b;
+  uint8_t shift = 0;
+  do {
+    b = bin_byte();
+    if (b < 0) return 0;
+    v |= (uint32_t)(b & 0x7F) << shift;
+    shift += 7;
+  } while ((b & 0x80) && shift < 35);
+  return v;
+}
+
+static void drawbin()
+{
+  long bx = lround(posx * WDB_UNITS_PER_MM), by = lround(posy * WDB_UNITS_PER_MM);  //当前位置，0.01mm，整数累加不漂移
+  long ops = 0;
+  bin_check = myFile.read() & WDB_FLAG_CHECK;
+  bin_crc = 0;
+
+  while (myFile.available()) {
+    uint8_t crc = bin_crc;  //操作码之前的校验值，校验点比的是它
+    int op = bin_byte();
+    ops++;
+    switch (op) {
+      case WDB_OP_LINE:
+      case WDB_OP_RAPID:
+        bx += wdb_unzigzag(bin_varint());
+        by += wdb_unzigzag(bin_varint());
+        move_rate = op == WDB_OP_RAPID ? RAPID_FEED_RATE : feed_rate;
+        line(bx / (float)WDB_UNITS_PER_MM, by / (float)WDB_UNITS_PER_MM);
+        break;
+      case WDB_OP_PEN_UP:   pen_up();   break;
+      case WDB_OP_PEN_DOWN: pen_down(); break;
+      case WDB_OP_FEED:     feed_rate = bin_varint(); break;
+      case WDB_OP_DWELL:
+        pen_wait();
+        delay(bin_varint());
+        break;
+      case WDB_OP_CHECK:
+        if (bin_byte() != crc) {
+          pen_up();
+          Serial.print("Checksum error at op ");
+          Serial.println(ops);
+          return;
+        }
+        bin_crc = 0;
+        break;
+      case WDB_OP_END:
+        break;
+      default:
+        pen_up();
+        Serial.print("Bad op at ");
+        Serial.println(ops);
+        return;
+    }
+    if (op == WDB_OP_END) break;
+  }
+  pen_up();
+  Serial.print("Done: ");
+  Serial.print(ops);
+  Serial.println(" ops");
+}
+
+//文件头是 "WDB" 加版本号时按二进制执行，否则从头按G代码读
+static bool bin_header() {
+  if (myFile.read() == 'W' && myFile.read() == 'D' && myFile.read() == 'B' && myFile.read() == WDB_VERSION) return true;
+  myFile.seek(0);
+  return false;
 }
 
 //**********************
 void drawfile( String filename)
 {
 
-  String rd="";
   int line=0;
-  char rr=0;
   Serial.print("[");
   Serial.print(filename);
   myFile = SD.open(filename);
   
   if (myFile) {
     Serial.println("] Opened");
+
+    if (bin_header()) {
+      drawbin();
+      myFile.close();
+      return;
+    }
     
+    int last = '\n';  //空文件不算一行
     while (myFile.available()) {
-      rr=myFile.read();
-      
-      if (rr == char(10)) 
+      last = myFile.read();
+      if (gcode.parse(last)) 
        {
           line++;
           Serial.print("Run nc #");
-          Serial.print(line);
-          Serial.println(" : "+rd);
-          nc(rd);
-          rd="";
+          Serial.println(line);
+          nc();
         }
-       else
-         rd+=rr;
-        
     }
+    if (last != '\n' && gcode.parse('\n')) nc();  //最后一行没有换行符；有的话再送一个就多出一个空行
+    Serial.print("Done: ");
+    Serial.print(gcode.lines());
+    Serial.print(" lines, ");
+    Serial.print(myFile.size());
+    Serial.print(" bytes, skipped ");  //注释、跳段、空白
+    Serial.println(gcode.skipped());
     
     myFile.close();
     
@@ -477,6 +634,8 @@ void setup() {
   //缩放比例
   mode_scale = 1;
 
+  gcode.polyline(nc_point);
+
   if (!SD.begin(4)) {
     Serial.println("initialization SD failed!");
     while (1);